@@ -1,15 +1,30 @@
+#include "atlas_generator/Cache/Hash.h"
 #include "atlas_generator/Generator.h"
+#include "atlas_generator/Image/RawImageFile.h"
 #include "core/io/file_stream.h"
 #include "core/stb/stb.h"
 
 #include <core/time/timer.h>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 namespace fs = std::filesystem;
 
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 #include "atlas_generator/PackagingException.h"
 using namespace wk;
 using namespace AtlasGenerator;
@@ -19,11 +34,28 @@ using namespace AtlasGenerator;
 void print_help(char* executable) {
     print("Sc Atlas Generator Command Line App: ");
     print("Usage: " << executable << " [Folder name with output] ...args");
-    print("Arguments: Paths to images or to folder with image files");
+    print("Arguments: Paths to images or to folder with image files (.png or .rawimg)");
     print("Flags: ");
     print("--force: rewrite output folder even if it already exists");
     print("--debug: draws and shows atlas of polygons and atlas itself");
     print("--item-debug: draws and shows polygon for each item");
+    print("--split-islands: packs separated opaque regions of images as independent parts");
+    print("--split-oversized: packs images that do not fit into page as several overlapping tiles");
+    print("--scales [0.5,0.25]: additionally writes downsampled atlas sets with provided scales");
+    print("--block-size [4]: aligns items to grid of texture compression blocks");
+    print("--compress [bc1|bc3|bc7|etc2|etc2a]: additionally writes block compressed atlases as KTX files");
+    print("--minimize-pages: repacks last atlas into the smallest possible size");
+    print("--page-constraint [mul4|pot]: rounds atlas dimensions to multiple of 4 or power of two");
+    print("--preset [draft|balanced|max-density]: packing speed preset, max-density enables portfolio");
+    print("--portfolio: packs with several strategies in parallel and keeps the best layout");
+    print("--hierarchical: packs small images in clusters first, for very large image counts");
+    print("--memory-budget [MB]: limits memory of images and atlases, extra images are moved to scratch file");
+    print("--on-failure [skip|rectangle]: packs the rest of images when some of them fail and lists failures");
+    print("--report: writes packing efficiency and atlas occupancy report to report.json");
+    print("--threads [N]: count of generator threads, 0 means all cores");
+    print("--pin-threads: binds generator threads to CPU cores");
+    print("--watch: keeps running and regenerates atlases when input files are changed");
+    print("--cache [folder]: reuses outputs of previous runs with the same input files and options");
 }
 
 class ProgramOptions {
@@ -50,28 +82,167 @@ public:
                 continue;
             }
 
+            if (argument == "--split-islands") {
+                split_islands = true;
+                continue;
+            }
+
+            if (argument == "--split-oversized") {
+                split_oversized = true;
+                continue;
+            }
+
+            if (argument == "--block-size" && argc > i + 1) {
+                block_size = (uint8_t) std::stoi(argv[++i]);
+                continue;
+            }
+
+            if (argument == "--compress" && argc > i + 1) {
+                std::string format = argv[++i];
+                if (format == "bc1") {
+                    compression = BlockFormat::BC1;
+                } else if (format == "bc3") {
+                    compression = BlockFormat::BC3;
+                } else if (format == "bc7") {
+                    compression = BlockFormat::BC7;
+                } else if (format == "etc2") {
+                    compression = BlockFormat::ETC2_RGB;
+                } else if (format == "etc2a") {
+                    compression = BlockFormat::ETC2_RGBA;
+                } else {
+                    print("Unknown compression format " << format);
+                }
+                continue;
+            }
+
+            if (argument == "--minimize-pages") {
+                minimize_pages = true;
+                continue;
+            }
+
+            if (argument == "--page-constraint" && argc > i + 1) {
+                std::string constraint = argv[++i];
+                if (constraint == "mul4") {
+                    page_constraint = Config::PageConstraint::MultipleOf4;
+                } else if (constraint == "pot") {
+                    page_constraint = Config::PageConstraint::PowerOfTwo;
+                } else {
+                    print("Unknown page constraint " << constraint);
+                }
+                continue;
+            }
+
+            if (argument == "--preset" && argc > i + 1) {
+                std::string name = argv[++i];
+                if (name == "draft") {
+                    preset = Config::PackingPreset::Draft;
+                } else if (name == "balanced") {
+                    preset = Config::PackingPreset::Balanced;
+                } else if (name == "max-density") {
+                    preset = Config::PackingPreset::MaxDensity;
+                } else {
+                    print("Unknown packing preset " << name);
+                }
+                continue;
+            }
+
+            if (argument == "--portfolio") {
+                packing_portfolio = true;
+                continue;
+            }
+
+            if (argument == "--hierarchical") {
+                hierarchical_packing = true;
+                continue;
+            }
+
+            if (argument == "--memory-budget" && argc > i + 1) {
+                memory_budget = (size_t) std::stoull(argv[++i]) * 1024 * 1024;
+                continue;
+            }
+
+            if (argument == "--on-failure" && argc > i + 1) {
+                std::string policy = argv[++i];
+                if (policy == "skip") {
+                    failure_policy = Config::FailurePolicy::Skip;
+                } else if (policy == "rectangle") {
+                    failure_policy = Config::FailurePolicy::Rectangle;
+                } else {
+                    print("Unknown failure policy " << policy);
+                }
+                continue;
+            }
+
+            if (argument == "--report") {
+                write_report = true;
+                continue;
+            }
+
+            if (argument == "--threads" && argc > i + 1) {
+                threads = (uint16_t) std::stoi(argv[++i]);
+                continue;
+            }
+
+            if (argument == "--pin-threads") {
+                pin_threads = true;
+                continue;
+            }
+
+            if (argument == "--cache" && argc > i + 1) {
+                cache = argv[++i];
+                continue;
+            }
+
+            if (argument == "--watch") {
+                watch = true;
+                continue;
+            }
+
+            if (argument == "--scales" && argc > i + 1) {
+                std::stringstream stream(argv[++i]);
+                std::string scale;
+                while (std::getline(stream, scale, ',')) {
+                    scale_levels.push_back(std::stof(scale));
+                }
+                continue;
+            }
+
             // Paths
             if (!fs::exists(argument)) {
                 print("Unknown or wrong agument " << argument);
+                continue;
             }
 
-            auto valid_path = [](fs::path path) {
-                if (path.extension() == ".png")
-                    return true;
+            inputs.push_back(argument);
+        }
+
+        collect_files();
+    }
+
+    // Gathers image files from input paths. Called again in watch mode to pick up new files
+    void collect_files() {
+        files.clear();
+
+        auto valid_path = [](fs::path path) {
+            if (path.extension() == ".png" || is_raw_image_file(path))
+                return true;
 
-                return false;
-            };
+            return false;
+        };
 
-            if (fs::is_directory(argument)) {
-                for (fs::path path : fs::directory_iterator(argument)) {
+        for (const fs::path& input : inputs) {
+            if (fs::is_directory(input)) {
+                for (fs::path path : fs::directory_iterator(input)) {
                     if (valid_path(path))
                         files.push_back(path);
                 }
             } else {
-                if (valid_path(argument))
-                    files.push_back(argument);
+                if (valid_path(input))
+                    files.push_back(input);
             }
         }
+
+        std::sort(files.begin(), files.end());
     }
 
     static int last_argument_index() {
@@ -82,10 +253,199 @@ public:
 
 public:
     fs::path output;
+    std::vector<fs::path> inputs;
     std::vector<fs::path> files;
     bool force_output = false;
     bool is_debug = false;
     bool is_item_debug = false;
+    bool split_islands = false;
+    bool split_oversized = false;
+    std::vector<float> scale_levels;
+    uint8_t block_size = 1;
+    std::optional<BlockFormat> compression;
+    bool minimize_pages = false;
+    Config::PageConstraint page_constraint = Config::PageConstraint::None;
+    std::optional<Config::PackingPreset> preset;
+    bool packing_portfolio = false;
+    bool hierarchical_packing = false;
+    size_t memory_budget = 0;
+    Config::FailurePolicy failure_policy = Config::FailurePolicy::Throw;
+    bool write_report = false;
+    uint16_t threads = 0;
+    bool pin_threads = false;
+    bool watch = false;
+    std::optional<fs::path> cache;
+};
+
+// State that is kept between runs in watch mode
+class WarmState {
+public:
+    struct CachedImage {
+        fs::file_time_type time;
+        RawImageRef image;
+    };
+
+public:
+    // Returns decoded image, file is decoded again only if it was modified
+    RawImageRef load_image(const fs::path& path, bool luminance) {
+        fs::file_time_type time = fs::last_write_time(path);
+
+        auto it = images.find(path.string());
+        if (it != images.end() && it->second.time == time) {
+            return it->second.image;
+        }
+
+        RawImageRef image;
+        if (is_raw_image_file(path)) {
+            image = load_raw_image(path);
+        } else {
+            InputFileStream file(path);
+            stb::load_image(file, image);
+        }
+
+        if (luminance) {
+            RawImageRef gray =
+                CreateRef<RawImage>(image->width(), image->height(), Image::PixelDepth::LUMINANCE8_ALPHA8);
+            image->copy(*gray);
+            image = gray;
+        }
+
+        images[path.string()] = {time, image};
+        return image;
+    }
+
+    // Drops images of removed files and polygons of old image versions
+    void trim(const std::vector<fs::path>& files) {
+        std::set<std::string> paths;
+        for (const fs::path& path : files) {
+            paths.insert(path.string());
+        }
+
+        for (auto it = images.begin(); it != images.end();) {
+            if (paths.count(it->first)) {
+                ++it;
+            } else {
+                it = images.erase(it);
+            }
+        }
+
+        if (polygons->size() > files.size() * 2) {
+            polygons->clear();
+        }
+    }
+
+public:
+    std::unordered_map<std::string, CachedImage> images;
+
+    Ref<ThreadPool> pool;
+    Ref<PolygonCache> polygons = CreateRef<PolygonCache>();
+
+    // Content hashes of written output files
+    std::map<fs::path, size_t> outputs;
+};
+
+// Blocks until input files are changed. Uses inotify on Linux and polling of modification time elsewhere
+class InputWatcher {
+public:
+    using Snapshot = std::map<fs::path, fs::file_time_type>;
+
+public:
+    InputWatcher(const std::vector<fs::path>& inputs) :
+        m_inputs(inputs) {
+        m_snapshot = snapshot();
+
+#if defined(__linux__)
+        m_descriptor = inotify_init1(IN_CLOEXEC);
+        if (m_descriptor < 0)
+            return;
+
+        std::set<fs::path> directories;
+        for (const fs::path& input : m_inputs) {
+            directories.insert(fs::is_directory(input) ? input : fs::absolute(input).parent_path());
+        }
+
+        for (const fs::path& directory : directories) {
+            inotify_add_watch(m_descriptor,
+                              directory.string().c_str(),
+                              IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+        }
+#endif
+    }
+
+    ~InputWatcher() {
+#if defined(__linux__)
+        if (m_descriptor >= 0) {
+            close(m_descriptor);
+        }
+#endif
+    }
+
+    void wait() {
+        while (true) {
+#if defined(__linux__)
+            if (m_descriptor >= 0) {
+                drain(-1);
+
+                // Editors often write file by several operations, so events are collected until things settle down
+                while (drain(100)) {
+                }
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            }
+#else
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+#endif
+
+            Snapshot current = snapshot();
+            if (current != m_snapshot) {
+                m_snapshot = std::move(current);
+                return;
+            }
+        }
+    }
+
+private:
+    Snapshot snapshot() const {
+        Snapshot result;
+        std::error_code error;
+
+        auto add_file = [&](const fs::path& path) {
+            fs::file_time_type time = fs::last_write_time(path, error);
+            if (!error) {
+                result[path] = time;
+            }
+        };
+
+        for (const fs::path& input : m_inputs) {
+            if (fs::is_directory(input, error)) {
+                for (const fs::path& path : fs::directory_iterator(input, error)) {
+                    add_file(path);
+                }
+            } else {
+                add_file(input);
+                add_file(fs::path(input).replace_extension().concat("_guide.txt"));
+            }
+        }
+
+        return result;
+    }
+
+#if defined(__linux__)
+    // Reads pending events. Returns false if there were no events during timeout
+    bool drain(int timeout) {
+        pollfd descriptor = {m_descriptor, POLLIN, 0};
+        if (poll(&descriptor, 1, timeout) <= 0)
+            return false;
+
+        char buffer[4096];
+        return read(m_descriptor, buffer, sizeof(buffer)) > 0;
+    }
+
+    int m_descriptor = -1;
+#endif
+
+    std::vector<fs::path> m_inputs;
+    Snapshot m_snapshot;
 };
 
 #pragma region CV Debug Functions
@@ -155,46 +515,208 @@ void ShowContour(cv::Mat& src, std::vector<AtlasGenerator::Vertex>& points) {
 
 #pragma endregion
 
-void process(ProgramOptions& options) {
-    if (fs::exists(options.output) && fs::is_directory(options.output)) {
-        if (options.force_output) {
-            fs::remove_all(options.output);
-        } else {
-            throw Exception("Folder already exist");
+void write_ktx(const fs::path& path, const RawImage& image, BlockFormat format, const std::vector<uint8_t>& blocks) {
+    constexpr uint8_t identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    uint32_t internal_format = 0;
+    uint32_t base_format = 0x1908; // GL_RGBA
+    switch (format) {
+        case BlockFormat::BC1:
+            internal_format = 0x83F1; // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+            break;
+        case BlockFormat::BC3:
+            internal_format = 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+            break;
+        case BlockFormat::BC7:
+            internal_format = 0x8E8C; // GL_COMPRESSED_RGBA_BPTC_UNORM
+            break;
+        case BlockFormat::ETC2_RGB:
+            internal_format = 0x9274; // GL_COMPRESSED_RGB8_ETC2
+            base_format = 0x1907;     // GL_RGB
+            break;
+        case BlockFormat::ETC2_RGBA:
+            internal_format = 0x9278; // GL_COMPRESSED_RGBA8_ETC2_EAC
+            break;
+    }
+
+    const uint32_t header[13] = {0x04030201,
+                                 0,
+                                 1,
+                                 0,
+                                 internal_format,
+                                 base_format,
+                                 image.width(),
+                                 image.height(),
+                                 0,
+                                 0,
+                                 1,
+                                 1,
+                                 0};
+    const uint32_t image_size = (uint32_t) blocks.size();
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*) identifier, sizeof(identifier));
+    file.write((const char*) header, sizeof(header));
+    file.write((const char*) &image_size, sizeof(image_size));
+    file.write((const char*) blocks.data(), blocks.size());
+}
+
+// Writes file through temporary one, so readers never see partially written output
+template <typename F>
+void write_atomic(const fs::path& path, F write) {
+    fs::path temporary = fs::path(path).concat(".tmp");
+    write(temporary);
+    fs::rename(temporary, path);
+}
+
+// Writes packing report as JSON object
+void write_report(const fs::path& path,
+                  const AtlasGenerator::PackingReport& report,
+                  const std::vector<AtlasGenerator::ItemFailure>& failures) {
+    std::ofstream file(path);
+    file << std::fixed << std::setprecision(4);
+
+    file << "{" << std::endl;
+    file << "  \"cached\": " << (report.cached ? "true" : "false") << "," << std::endl;
+    file << "  \"item_count\": " << report.item_count << "," << std::endl;
+    file << "  \"unique_item_count\": " << report.unique_item_count << "," << std::endl;
+    file << "  \"duplicate_count\": " << report.duplicate_count << "," << std::endl;
+    file << "  \"empty_count\": " << report.empty_count << "," << std::endl;
+    file << "  \"colorfill_count\": " << report.colorfill_count << "," << std::endl;
+    file << "  \"rectangle_count\": " << report.rectangle_count << "," << std::endl;
+    file << "  \"unique_opaque_pixels\": " << report.unique_opaque_pixels << "," << std::endl;
+    file << "  \"atlas_bytes\": " << report.atlas_bytes << "," << std::endl;
+    file << "  \"duplicate_bytes\": " << report.duplicate_bytes << "," << std::endl;
+    file << "  \"bytes_per_opaque_pixel\": " << report.bytes_per_opaque_pixel() << "," << std::endl;
+
+    file << "  \"pages\": [";
+    for (size_t i = 0; report.pages.size() > i; i++) {
+        const AtlasGenerator::PageReport& page = report.pages[i];
+
+        file << (i ? "," : "") << std::endl;
+        file << "    {\"width\": " << page.width << ", \"height\": " << page.height
+             << ", \"item_count\": " << page.item_count << ", \"opaque_pixels\": " << page.opaque_pixels
+             << ", \"opaque_coverage\": " << page.opaque_coverage() << ", \"polygon_area\": " << page.polygon_area
+             << ", \"polygon_coverage\": " << page.polygon_coverage()
+             << ", \"extrusion_area\": " << page.extrusion_area << ", \"wasted_area\": " << page.wasted_area << "}";
+    }
+    file << std::endl << "  ]," << std::endl;
+
+    file << "  \"failures\": [";
+    for (size_t i = 0; failures.size() > i; i++) {
+        const AtlasGenerator::ItemFailure& failure = failures[i];
+
+        file << (i ? "," : "") << std::endl;
+        file << "    {\"index\": " << failure.index << ", \"reason\": \""
+             << AtlasGenerator::PackagingException(failure.reason).what() << "\"}";
+    }
+    file << std::endl << "  ]" << std::endl;
+    file << "}" << std::endl;
+}
+
+// Hash of everything that affects output: content of input files and guides, their names and options
+Hash128 input_key(const ProgramOptions& options) {
+    // Must be changed with changes of output format
+    constexpr uint32_t version = 1;
+
+    Hasher hasher;
+    hasher.update(version);
+    hasher.update(AtlasGenerator::ResultCache::Version);
+
+    auto update_string = [&hasher](const std::string& value) {
+        hasher.update<uint64_t>(value.size());
+        hasher.update(value.data(), value.size());
+    };
+
+    auto update_file = [&hasher](const fs::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        hasher.update(file.good());
+
+        char buffer[1 << 16];
+        while (file) {
+            file.read(buffer, sizeof(buffer));
+            hasher.update(buffer, (size_t) file.gcount());
         }
+    };
+
+    for (const fs::path& path : options.files) {
+        update_string(path.string());
+        update_file(path);
+        update_file(fs::path(path).replace_extension().concat("_guide.txt"));
+    }
+
+    hasher.update(options.split_islands);
+    hasher.update(options.split_oversized);
+    hasher.update(options.block_size);
+    hasher.update(options.minimize_pages);
+    hasher.update(options.page_constraint);
+    hasher.update(options.preset.has_value() ? (int) options.preset.value() : -1);
+    hasher.update(options.packing_portfolio);
+    hasher.update(options.hierarchical_packing);
+    hasher.update(options.failure_policy);
+    hasher.update(options.write_report);
+    hasher.update(options.compression.has_value() ? (int) options.compression.value() : -1);
+    hasher.update<uint64_t>(options.scale_levels.size());
+    for (float level : options.scale_levels) {
+        hasher.update(level);
     }
 
-    fs::create_directory(options.output);
+    return hasher.digest();
+}
 
-    fs::path atlas_data_output = options.output / "atlas.txt";
-    std::ofstream atlas_data(atlas_data_output);
+// Copies all files of folder, every file is replaced atomically
+void copy_files(const fs::path& source, const fs::path& destination) {
+    fs::create_directories(destination);
+
+    for (const fs::path& path : fs::directory_iterator(source)) {
+        write_atomic(destination / path.filename(), [&path](const fs::path& temporary) {
+            fs::copy_file(path, temporary, fs::copy_options::overwrite_existing);
+        });
+    }
+}
+
+void process(ProgramOptions& options, WarmState& state) {
+    fs::create_directories(options.output);
+
+    std::optional<fs::path> cached_output;
+    if (options.cache.has_value()) {
+        cached_output = options.cache.value() / input_key(options).hex();
+
+        if (fs::is_directory(cached_output.value())) {
+            std::map<fs::path, size_t> outputs;
+            for (const fs::path& path : fs::directory_iterator(cached_output.value())) {
+                outputs[options.output / path.filename()] = 0;
+            }
+
+            for (auto iter = state.outputs.begin(); iter != state.outputs.end(); ++iter) {
+                std::error_code error;
+                if (!outputs.count(iter->first))
+                    fs::remove(iter->first, error);
+            }
+
+            copy_files(cached_output.value(), options.output);
+            state.outputs = std::move(outputs);
+
+            print("Restored from cache " << cached_output.value());
+            return;
+        }
+    }
+
+    std::stringstream atlas_data;
 
     std::vector<AtlasGenerator::Item> items;
     items.reserve(options.files.size());
 
     std::map<size_t, Rect> guides;
-    std::map<size_t, AtlasGenerator::Item::Transformation> guide_transforms;
+    std::map<size_t, AtlasGenerator::Item::Transformation<int32_t>> guide_transforms;
 
     for (fs::path& path : options.files) {
-        if (path.extension() != ".png")
-            continue;
-
         std::string basename = fs::path(path.filename()).replace_extension().string();
         fs::path guide_path = fs::path(path).replace_extension().concat("_guide.txt");
 
         if (!fs::exists(guide_path)) {
-            if (basename.size() > 3 && basename.substr(basename.size() - 3) == "_la") {
-                InputFileStream file(path);
-                RawImageRef image;
-                stb::load_image(file, image);
-
-                RawImage gray(image->width(), image->height(), Image::PixelDepth::LUMINANCE8_ALPHA8);
-                image->copy(gray);
-
-                items.emplace_back(gray);
-            } else {
-                items.emplace_back(path);
-            }
+            bool luminance = basename.size() > 3 && basename.substr(basename.size() - 3) == "_la";
+            items.emplace_back(state.load_image(path, luminance));
         } else {
             std::vector<float> guide;
             std::ifstream guide_file(guide_path);
@@ -212,9 +734,10 @@ void process(ProgramOptions& options) {
                                         (int32_t) ceil(guide[1]),
                                         (int32_t) ceil(guide[2]));
 
-            AtlasGenerator::Item item(path, true);
+            AtlasGenerator::Item item(state.load_image(path, false), true);
 
-            AtlasGenerator::Item::Transformation transform(0.0, Point(-(item.width() / 2), -(item.height() / 2)));
+            AtlasGenerator::Item::Transformation<int32_t> transform(0.0,
+                                                                    Point(-(item.width() / 2), -(item.height() / 2)));
 
             guide_transforms[items.size()] = transform;
 
@@ -233,13 +756,33 @@ void process(ProgramOptions& options) {
 
     uint8_t scale_factor = 1;
     AtlasGenerator::Config config(4096, 4096, scale_factor, 2);
+    config.set_split_islands(options.split_islands);
+    config.set_split_oversized(options.split_oversized);
+    config.set_scale_levels(options.scale_levels);
+    config.set_block_size(options.block_size);
+    config.set_page_optimization(options.minimize_pages, options.page_constraint);
+    if (options.preset.has_value()) {
+        config.set_packing_preset(options.preset.value());
+    }
+    if (options.packing_portfolio) {
+        config.set_packing_portfolio(true);
+    }
+    config.set_hierarchical_packing(options.hierarchical_packing);
+    config.set_memory_budget(options.memory_budget);
+    config.set_failure_policy(options.failure_policy);
+    config.set_threads(options.threads, options.pin_threads);
 
     config.progress = [&items](size_t count) {
         std::cout << std::string(100, '\b') << count + 1 << "\\" << items.size() << std::flush;
     };
 
     size_t bin_count = 0;
-    AtlasGenerator::Generator generator(config);
+    if (!state.pool) {
+        state.pool = CreateRef<ThreadPool>(config.threads(), config.pin_threads());
+    }
+    state.trim(options.files);
+
+    AtlasGenerator::Generator generator(config, state.pool, state.polygons);
     {
         Timer timer;
         std::cout << "0\\" << items.size();
@@ -262,27 +805,82 @@ void process(ProgramOptions& options) {
             return;
         }
         print("Packaging done by " << timer.elapsed() / 1000 << "s");
+        print("Peak memory: " << AtlasGenerator::BufferManager::peak_rss() / (1024 * 1024) << "MB, images and atlases: "
+                              << generator.peak_memory() / (1024 * 1024) << "MB");
+
+        for (const AtlasGenerator::ItemFailure& failure : generator.failures()) {
+            print("Failed to package item " << options.files[failure.index] << ": "
+                                            << AtlasGenerator::PackagingException(failure.reason).what());
+        }
     }
 
+    std::map<fs::path, size_t> outputs;
+
+    // Returns false if file with the same content was already written by previous run
+    auto need_output = [&state, &outputs](const fs::path& path, size_t hash) {
+        outputs[path] = hash;
+
+        auto it = state.outputs.find(path);
+        return it == state.outputs.end() || it->second != hash || !fs::exists(path);
+    };
+
+    auto pixels_hash = [&state](const RawImage& image) {
+        const uint64_t seed = (uint64_t) image.width() << 16 | image.height();
+        return (size_t) hash128(*state.pool, image.data(), image.data_length(), seed).low;
+    };
+
     for (uint8_t i = 0; bin_count > i; i++) {
         RawImage& image = generator.get_atlas(i);
         std::string destination =
             fs::path(options.output / fs::path("atlas_").concat(std::to_string(i)).concat(".png")).string();
 
-        wk::OutputFileStream file(destination);
-        wk::stb::write_image(image, wk::stb::ImageFormat::PNG, file);
-    }
+        const size_t image_hash = pixels_hash(image);
+        if (need_output(destination, image_hash)) {
+            write_atomic(destination, [&image](const fs::path& path) {
+                wk::OutputFileStream file(path);
+                wk::stb::write_image(image, wk::stb::ImageFormat::PNG, file);
+            });
+        }
 
-    for (size_t i = 0; items.size() > i; i++) {
-        AtlasGenerator::Item& item = items[i];
-        fs::path& path = options.files[i];
+        if (options.compression.has_value()) {
+            fs::path ktx_destination = fs::path(destination).replace_extension(".ktx");
 
-        atlas_data << "path=" << path << std::endl;
-        atlas_data << "textureIndex=" << std::to_string(item.texture_index) << std::endl;
+            if (need_output(ktx_destination, image_hash ^ (size_t) options.compression.value())) {
+                std::vector<uint8_t> blocks;
+                generator.get_compressed_atlas(i, options.compression.value(), blocks);
+                write_atomic(ktx_destination, [&](const fs::path& path) {
+                    write_ktx(path, image, options.compression.value(), blocks);
+                });
+            }
+        }
+
+        for (size_t level = 0; config.scale_levels().size() > level; level++) {
+            std::string scaled_destination = fs::path(options.output / fs::path("atlas_")
+                                                                           .concat(std::to_string(i))
+                                                                           .concat("_")
+                                                                           .concat(std::to_string(level + 1))
+                                                                           .concat(".png"))
+                                                 .string();
+
+            RawImage& scaled_image = generator.get_atlas(i, level);
+            if (need_output(scaled_destination, pixels_hash(scaled_image))) {
+                write_atomic(scaled_destination, [&scaled_image](const fs::path& path) {
+                    wk::OutputFileStream scaled_file(path);
+                    wk::stb::write_image(scaled_image, wk::stb::ImageFormat::PNG, scaled_file);
+                });
+            }
+        }
+    }
+
+    auto write_polygon = [&atlas_data, &scale_factor, &config, &generator](
+                             size_t texture_index,
+                             const std::vector<AtlasGenerator::Vertex>& vertices,
+                             const AtlasGenerator::Item::Transformation<int32_t>& transform) {
+        atlas_data << "textureIndex=" << std::to_string(texture_index) << std::endl;
 
         atlas_data << "uv=";
-        for (AtlasGenerator::Vertex vertex : item.vertices) {
-            item.transform.transform_point(vertex.uv);
+        for (AtlasGenerator::Vertex vertex : vertices) {
+            transform.transform_point(vertex.uv);
             atlas_data << "[";
             atlas_data << std::to_string(vertex.uv.x / scale_factor);
             atlas_data << ",";
@@ -292,8 +890,24 @@ void process(ProgramOptions& options) {
 
         atlas_data << std::endl;
 
+        for (size_t level = 0; config.scale_levels().size() > level; level++) {
+            atlas_data << "uv_" << std::to_string(level + 1) << "=";
+            for (AtlasGenerator::Vertex vertex : vertices) {
+                transform.transform_point(vertex.uv);
+                PointUV uv = generator.get_scaled_uv(texture_index, level, vertex.uv);
+
+                atlas_data << "[";
+                atlas_data << std::to_string(uv.x);
+                atlas_data << ",";
+                atlas_data << std::to_string(uv.y);
+                atlas_data << "]";
+            }
+
+            atlas_data << std::endl;
+        }
+
         atlas_data << "xy=";
-        for (AtlasGenerator::Vertex& vertex : item.vertices) {
+        for (const AtlasGenerator::Vertex& vertex : vertices) {
             atlas_data << "[";
             atlas_data << std::to_string(vertex.xy.x);
             atlas_data << ",";
@@ -301,10 +915,72 @@ void process(ProgramOptions& options) {
             atlas_data << "]";
         }
 
-        atlas_data << std::endl << std::endl;
+        atlas_data << std::endl;
+    };
+
+    for (size_t i = 0; items.size() > i; i++) {
+        AtlasGenerator::Item& item = items[i];
+        fs::path& path = options.files[i];
+
+        atlas_data << "path=" << path << std::endl;
+
+        if (item.status() == AtlasGenerator::Item::Status::Empty) {
+            atlas_data << "empty" << std::endl;
+        } else if (item.status() == AtlasGenerator::Item::Status::Skipped) {
+            atlas_data << "skipped" << std::endl;
+        } else if (item.is_multipart()) {
+            atlas_data << "parts=" << std::to_string(item.parts.size()) << std::endl;
+            for (const AtlasGenerator::Item::Part& part : item.parts) {
+                write_polygon(part.texture_index, part.vertices, part.transform);
+            }
+        } else {
+            write_polygon(item.texture_index, item.vertices, item.transform);
+        }
+
+        atlas_data << std::endl;
+    }
+
+    write_atomic(options.output / "atlas.txt", [&atlas_data](const fs::path& path) {
+        std::ofstream file(path);
+        file << atlas_data.str();
+    });
+
+    if (options.write_report) {
+        write_atomic(options.output / "report.json", [&generator](const fs::path& path) {
+            write_report(path, generator.report(), generator.failures());
+        });
+    }
+
+    // Pages of previous run that are not produced anymore
+    for (auto iter = state.outputs.begin(); iter != state.outputs.end(); ++iter) {
+        if (!outputs.count(iter->first)) {
+            std::error_code error;
+            fs::remove(iter->first, error);
+        }
+    }
+    state.outputs = std::move(outputs);
+
+    // Failures are printed only by generation, so partial outputs are not cached
+    if (cached_output.has_value() && generator.failures().empty()) {
+        // Files of this run are copied to temporary folder first, so cache never contains partial results.
+        // Folder name is unique, so processes that share cache never write into the same folder
+        std::stringstream suffix;
+        suffix << ".tmp" << std::hex << std::random_device()() << std::this_thread::get_id();
+        fs::path temporary = fs::path(cached_output.value()).concat(suffix.str());
+        std::error_code error;
+        fs::remove_all(temporary, error);
+
+        fs::create_directories(temporary);
+        for (auto iter = state.outputs.begin(); iter != state.outputs.end(); ++iter) {
+            fs::copy_file(iter->first, temporary / iter->first.filename(), fs::copy_options::overwrite_existing);
+        }
+        fs::rename(temporary, cached_output.value(), error);
+        if (error) {
+            fs::remove_all(temporary, error);
+        }
     }
 
-    if (options.is_debug) {
+    if (options.is_debug && !options.watch) {
         std::vector<cv::Mat> sheets;
         cv::RNG rng = cv::RNG(time(NULL));
 
@@ -347,23 +1023,32 @@ void process(ProgramOptions& options) {
             ShowImage("Atlas", sheets[i]);
         }
 
-        for (size_t i = 0; items.size() > i; i++) {
-            AtlasGenerator::Item& item = items[i];
-            Item::Transformation& transform = item.transform;
+        auto draw_polygon = [&sheets, &rng](size_t texture_index,
+                                            const std::vector<AtlasGenerator::Vertex>& vertices,
+                                            const Item::Transformation<int32_t>& transform) {
             std::vector<cv::Point> atlas_contour;
-            std::vector<cv::Point> item_contour;
-            fs::path& path = options.files[i];
 
-            for (AtlasGenerator::Vertex vertex : item.vertices) {
+            for (AtlasGenerator::Vertex vertex : vertices) {
                 transform.transform_point(vertex.uv);
 
                 atlas_contour.push_back(cv::Point(vertex.uv.x, vertex.uv.y));
-                item_contour.push_back(cv::Point(vertex.xy.x, vertex.xy.y));
             }
 
-            {
-                cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
-                fillPoly(sheets[item.texture_index], atlas_contour, color);
+            cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+            fillPoly(sheets[texture_index], atlas_contour, color);
+        };
+
+        for (AtlasGenerator::Item& item : items) {
+            if (item.status() == AtlasGenerator::Item::Status::Empty ||
+                item.status() == AtlasGenerator::Item::Status::Skipped)
+                continue;
+
+            if (item.is_multipart()) {
+                for (const AtlasGenerator::Item::Part& part : item.parts) {
+                    draw_polygon(part.texture_index, part.vertices, part.transform);
+                }
+            } else {
+                draw_polygon(item.texture_index, item.vertices, item.transform);
             }
         }
 
@@ -383,11 +1068,39 @@ int main(int argc, char* argv[]) {
 
     ProgramOptions options(argc, argv);
 
+    if (fs::exists(options.output) && fs::is_directory(options.output)) {
+        if (options.force_output) {
+            fs::remove_all(options.output);
+        } else {
+            print("Folder already exist");
+            return 1;
+        }
+    }
+
+    WarmState state;
+
     try {
-        process(options);
+        process(options, state);
     } catch (const std::exception& exception) {
         print(exception.what());
-        return 1;
+        if (!options.watch)
+            return 1;
+    }
+
+    if (!options.watch)
+        return 0;
+
+    InputWatcher watcher(options.inputs);
+    while (true) {
+        print("Watching for changes...");
+        watcher.wait();
+
+        options.collect_files();
+        try {
+            process(options, state);
+        } catch (const std::exception& exception) {
+            print(exception.what());
+        }
     }
 
     return 0;
@@ -0,0 +1,70 @@
+#include "Batch.h"
+
+namespace wk::AtlasGenerator {
+    Batch::Batch(size_t thread_count) :
+        Batch(CreateRef<ThreadPool>(thread_count)) {
+    }
+
+    Batch::Batch(Ref<ThreadPool> pool, Ref<PolygonCache> cache) :
+        m_pool(pool),
+        m_cache(cache) {
+        if (!m_pool) {
+            m_pool = CreateRef<ThreadPool>();
+        }
+
+        if (!m_cache) {
+            m_cache = CreateRef<PolygonCache>();
+        }
+    }
+
+    size_t Batch::run() {
+        m_cancelled = false;
+
+        Container<std::future<void>> results;
+        for (Job& job : m_jobs) {
+            if (job.done)
+                continue;
+
+            // Job does not reset cancellation itself, so cancel requested after this point always reaches it
+            job.generator->m_cancelled = false;
+            results.push_back(m_pool->submit_job([this, &job]() {
+                try {
+                    // Jobs that were not started before cancellation are skipped
+                    if (m_cancelled) {
+                        throw PackagingException(PackagingException::Reason::Cancelled);
+                    }
+
+                    job.atlas_count = job.run();
+                } catch (...) {
+                    job.error = std::current_exception();
+                }
+
+                job.done = true;
+            }));
+        }
+
+        for (auto& result : results) {
+            m_pool->wait(result);
+        }
+
+        size_t failed = 0;
+        for (const Job& job : m_jobs) {
+            if (job.error) {
+                failed++;
+            }
+        }
+
+        return failed;
+    }
+
+    void Batch::cancel() {
+        m_cancelled = true;
+        for (Job& job : m_jobs) {
+            job.generator->cancel();
+        }
+    }
+
+    void Batch::clear() {
+        m_jobs.clear();
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Generator.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+
+namespace wk::AtlasGenerator {
+    // Runs many independent atlas jobs concurrently over one thread pool and one polygon cache
+    class Batch {
+    public:
+        /// @param thread_count Count of threads for all jobs. 0 means hardware concurrency
+        Batch(size_t thread_count = 0);
+        Batch(Ref<ThreadPool> pool, Ref<PolygonCache> cache = nullptr);
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+    public:
+        /// @brief Adds job to batch. Items must stay alive until batch is done.
+        /// Thread settings of config are ignored, all jobs use thread pool of batch.
+        /// Jobs are started only by idle threads, waits inside of one job never run other jobs
+        /// @return Job index
+        template <typename T = Item>
+        size_t add(const Config& config, Container<T>& items) {
+            Job& job = m_jobs.emplace_back();
+            job.generator = CreateRef<Generator>(config, m_pool, m_cache);
+            job.run = [generator = job.generator.get(), &items]() { return generator->generate_items<T>(items); };
+
+            return m_jobs.size() - 1;
+        }
+
+        /// @brief Runs all jobs that were not run yet and waits for them.
+        /// Failure of one job does not stop other ones
+        /// @return Count of failed jobs
+        size_t run();
+
+        /// @brief Requests stop of all running jobs. Can be called from any thread
+        void cancel();
+
+        size_t size() const { return m_jobs.size(); };
+
+        /// @brief Generator of job with its atlases
+        Generator& generator(size_t job) { return *m_jobs[job].generator; };
+
+        /// @brief Count of atlases generated by job
+        size_t atlas_count(size_t job) const { return m_jobs[job].atlas_count; };
+
+        /// @brief Exception of failed job, empty if job succeeded
+        std::exception_ptr error(size_t job) const { return m_jobs[job].error; };
+
+        /// @brief Removes all jobs with their results. Polygon cache is kept
+        void clear();
+
+    private:
+        struct Job {
+            Ref<Generator> generator;
+            std::function<size_t()> run;
+
+            bool done = false;
+            size_t atlas_count = 0;
+            std::exception_ptr error;
+        };
+
+    private:
+        Ref<ThreadPool> m_pool;
+        Ref<PolygonCache> m_cache;
+
+        Container<Job> m_jobs;
+
+        std::atomic<bool> m_cancelled = false;
+    };
+}
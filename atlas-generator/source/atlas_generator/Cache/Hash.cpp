@@ -0,0 +1,245 @@
+#include "Hash.h"
+
+#include "atlas_generator/Threading/ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WK_HASH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Stripe accumulation follows XXH3 long input loop: 8 lanes of 64-bit accumulators,
+// each lane takes product of 32-bit halves of keyed input, so SSE2 processes two lanes by one instruction
+namespace wk::AtlasGenerator {
+    namespace {
+        constexpr size_t Lanes = 8;
+        constexpr size_t StripeSize = Lanes * sizeof(uint64_t);
+
+        // Stripes between accumulator scrambles, key slides by one lane for each stripe
+        constexpr size_t StripesPerBlock = 16;
+        constexpr size_t BlockSize = StripeSize * StripesPerBlock;
+
+        constexpr uint64_t Prime32_1 = 0x9E3779B1u;
+        constexpr uint64_t Prime32_2 = 0x85EBCA77u;
+        constexpr uint64_t Prime32_3 = 0xC2B2AE3Du;
+        constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t Prime64_3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t Prime64_5 = 0x27D4EB2F165667C5ull;
+
+        // Key material for stripes, scrambles and finalization
+        alignas(16) constexpr uint64_t Secret[Lanes + StripesPerBlock + 8] = {
+            0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+            0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+            0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull, 0xd8acdea946ef1938ull,
+            0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull,
+            0xc3ebd33483acc5eaull, 0xeb6313faffa081c5ull, 0x49daf0b751dd0d17ull, 0x9e68d429265516d3ull,
+            0xfca1477d58be162bull, 0xce31d07ad1b8f88full, 0x280416958f3acb45ull, 0x7e404bbbcafbd7afull,
+            0xaf8e2b42f1b7d1e4ull, 0x6b8f6db3d9b4e6a1ull, 0x39c5e1f2a0d3b7c8ull, 0x5e1d2f3c4b6a7988ull,
+            0xd2c4b6a89e7f6051ull, 0x8a9b7c6d5e4f3021ull, 0x1f2e3d4c5b6a7988ull, 0xf0e1d2c3b4a59687ull};
+
+#if !defined(WK_HASH_SSE2)
+        uint64_t read64(const uint8_t* data) {
+            uint64_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+#endif
+
+        uint64_t mul_fold(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+            const __uint128_t product = (__uint128_t) a * b;
+            return (uint64_t) product ^ (uint64_t) (product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            uint64_t high;
+            const uint64_t low = _umul128(a, b, &high);
+            return low ^ high;
+#else
+            const uint64_t a_low = a & 0xFFFFFFFFu, a_high = a >> 32;
+            const uint64_t b_low = b & 0xFFFFFFFFu, b_high = b >> 32;
+
+            const uint64_t low_low = a_low * b_low;
+            const uint64_t high_low = a_high * b_low;
+            const uint64_t low_high = a_low * b_high;
+            const uint64_t high_high = a_high * b_high;
+
+            const uint64_t cross = (low_low >> 32) + (high_low & 0xFFFFFFFFu) + low_high;
+            const uint64_t high = (high_low >> 32) + (cross >> 32) + high_high;
+            const uint64_t low = (cross << 32) | (low_low & 0xFFFFFFFFu);
+            return low ^ high;
+#endif
+        }
+
+        uint64_t avalanche(uint64_t value) {
+            value ^= value >> 37;
+            value *= 0x165667919E3779F9ull;
+            value ^= value >> 32;
+            return value;
+        }
+
+        struct State {
+            alignas(16) uint64_t acc[Lanes];
+
+            explicit State(uint64_t seed) :
+                acc{Prime32_3 + seed,
+                    Prime64_1 - seed,
+                    Prime64_2 + seed,
+                    Prime64_3 - seed,
+                    Prime64_4 + seed,
+                    Prime32_2 - seed,
+                    Prime64_5 + seed,
+                    Prime32_1 - seed} {
+            }
+
+            void accumulate(const uint8_t* stripe, const uint64_t* key) {
+#if defined(WK_HASH_SSE2)
+                __m128i* lanes = (__m128i*) acc;
+                for (size_t i = 0; Lanes / 2 > i; i++) {
+                    const __m128i data = _mm_loadu_si128((const __m128i*) stripe + i);
+                    const __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*) key + i));
+
+                    const __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                    const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                    lanes[i] = _mm_add_epi64(product, _mm_add_epi64(lanes[i], swapped));
+                }
+#else
+                for (size_t i = 0; Lanes > i; i++) {
+                    const uint64_t data = read64(stripe + i * sizeof(uint64_t));
+                    const uint64_t keyed = data ^ key[i];
+
+                    acc[i ^ 1] += data;
+                    acc[i] += (keyed & 0xFFFFFFFFu) * (keyed >> 32);
+                }
+#endif
+            }
+
+            void scramble(const uint64_t* key) {
+                for (size_t i = 0; Lanes > i; i++) {
+                    uint64_t value = acc[i];
+                    value ^= value >> 47;
+                    value ^= key[i];
+                    acc[i] = value * Prime32_1;
+                }
+            }
+
+            void block(const uint8_t* data) {
+                for (size_t stripe = 0; StripesPerBlock > stripe; stripe++) {
+                    accumulate(data + stripe * StripeSize, Secret + stripe);
+                }
+                scramble(Secret + StripesPerBlock);
+            }
+
+            // Remaining stripes of last block and zero padded last stripe
+            void tail(const uint8_t* data, size_t size) {
+                size_t stripe = 0;
+                for (; size >= (stripe + 1) * StripeSize; stripe++) {
+                    accumulate(data + stripe * StripeSize, Secret + stripe);
+                }
+
+                alignas(16) uint8_t last[StripeSize] = {};
+                if (size > stripe * StripeSize) {
+                    std::memcpy(last, data + stripe * StripeSize, size - stripe * StripeSize);
+                }
+                accumulate(last, Secret + StripesPerBlock - 1);
+            }
+
+            Hash128 digest(uint64_t size, uint64_t seed) const {
+                uint64_t low = size * Prime64_1 + seed;
+                uint64_t high = ~(size * Prime64_2) - seed;
+                for (size_t i = 0; Lanes > i; i += 2) {
+                    low += mul_fold(acc[i] ^ Secret[i], acc[i + 1] ^ Secret[i + 1]);
+                    high += mul_fold(acc[i] ^ Secret[Lanes + i + 1], acc[i + 1] ^ Secret[Lanes + i]);
+                }
+
+                return {avalanche(low), avalanche(high)};
+            }
+        };
+
+        // Hash of one chunk. With destination data is copied by blocks and hashed from destination
+        Hash128 hash_chunk(const uint8_t* data, uint8_t* destination, size_t size, uint64_t seed) {
+            State state(seed);
+
+            size_t offset = 0;
+            for (; size >= offset + BlockSize; offset += BlockSize) {
+                const uint8_t* block = data + offset;
+                if (destination) {
+                    std::memcpy(destination + offset, block, BlockSize);
+                    block = destination + offset;
+                }
+
+                state.block(block);
+            }
+
+            const uint8_t* tail = data + offset;
+            if (destination && size > offset) {
+                std::memcpy(destination + offset, tail, size - offset);
+                tail = destination + offset;
+            }
+            state.tail(tail, size - offset);
+
+            return state.digest(size, seed);
+        }
+
+        size_t chunk_count(size_t size) {
+            return (size + HashChunkSize - 1) / HashChunkSize;
+        }
+
+        // Big inputs are hashed again by digests of their chunks, chunk index is mixed into seed of each chunk
+        Hash128 hash_chunks(const std::vector<Hash128>& chunks, size_t size, uint64_t seed) {
+            return hash_chunk((const uint8_t*) chunks.data(), nullptr, chunks.size() * sizeof(Hash128), seed ^ size);
+        }
+
+        uint64_t chunk_seed(uint64_t seed, size_t index) {
+            return seed + index * Prime64_3;
+        }
+    }
+
+    std::string Hash128::hex() const {
+        std::stringstream result;
+        result << std::hex << std::setfill('0') << std::setw(16) << high << std::setw(16) << low;
+        return result.str();
+    }
+
+    Hash128 hash128(const void* data, size_t size, uint64_t seed) {
+        return copy_hash128(data, nullptr, size, seed);
+    }
+
+    Hash128 hash128(ThreadPool& pool, const void* data, size_t size, uint64_t seed) {
+        if (HashChunkSize >= size)
+            return hash_chunk((const uint8_t*) data, nullptr, size, seed);
+
+        std::vector<Hash128> chunks(chunk_count(size));
+        pool.enumerate(chunks.begin(), chunks.end(), [&](Hash128& chunk, size_t i) {
+            const size_t offset = i * HashChunkSize;
+            const size_t length = std::min(HashChunkSize, size - offset);
+            chunk = hash_chunk((const uint8_t*) data + offset, nullptr, length, chunk_seed(seed, i));
+        });
+
+        return hash_chunks(chunks, size, seed);
+    }
+
+    Hash128 copy_hash128(const void* source, void* destination, size_t size, uint64_t seed) {
+        if (HashChunkSize >= size)
+            return hash_chunk((const uint8_t*) source, (uint8_t*) destination, size, seed);
+
+        std::vector<Hash128> chunks(chunk_count(size));
+        for (size_t i = 0; chunks.size() > i; i++) {
+            const size_t offset = i * HashChunkSize;
+            const size_t length = std::min(HashChunkSize, size - offset);
+            uint8_t* output = destination ? (uint8_t*) destination + offset : nullptr;
+            chunks[i] = hash_chunk((const uint8_t*) source + offset, output, length, chunk_seed(seed, i));
+        }
+
+        return hash_chunks(chunks, size, seed);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+
+namespace wk::AtlasGenerator {
+    class ThreadPool;
+
+    // Inputs are hashed by chunks of that size, so big inputs can be hashed in parallel
+    constexpr size_t HashChunkSize = 1 << 20;
+
+    struct Hash128 {
+        uint64_t low = 0;
+        uint64_t high = 0;
+
+        bool operator==(const Hash128& other) const { return low == other.low && high == other.high; };
+        bool operator!=(const Hash128& other) const { return !(*this == other); };
+
+        /// @brief 32 hex digits, used as file name
+        std::string hex() const;
+    };
+
+    /// @brief Fast 128-bit non cryptographic hash. Result depends only on data and seed, so it can be stored between
+    /// runs. Inputs bigger than HashChunkSize are hashed by chunks and then by digests of chunks
+    Hash128 hash128(const void* data, size_t size, uint64_t seed = 0);
+
+    /// @brief The same hash with chunks hashed in parallel on pool
+    Hash128 hash128(ThreadPool& pool, const void* data, size_t size, uint64_t seed = 0);
+
+    /// @brief Copies data and hashes it in the same pass while copied bytes are still in cache.
+    /// Result is equal to hash128 of copied data
+    Hash128 copy_hash128(const void* source, void* destination, size_t size, uint64_t seed = 0);
+
+    // Incremental hash of sequence of values. Result depends on data and on its split between update calls
+    class Hasher {
+    public:
+        void update(const void* data, size_t size) {
+            const Hash128 value = hash128(data, size, m_state.low ^ m_state.high);
+            m_state = {value.low, value.high ^ m_state.high};
+        }
+
+        void update(const Hash128& value) { update(&value, sizeof(Hash128)); }
+
+        template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+        void update(T value) {
+            update(&value, sizeof(T));
+        }
+
+        Hash128 digest() const { return m_state; };
+
+    private:
+        Hash128 m_state;
+    };
+}
+
+template <>
+struct std::hash<wk::AtlasGenerator::Hash128> {
+    size_t operator()(const wk::AtlasGenerator::Hash128& value) const noexcept { return (size_t) value.low; }
+};
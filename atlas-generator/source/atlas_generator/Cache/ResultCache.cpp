@@ -0,0 +1,265 @@
+#include "ResultCache.h"
+
+#include "atlas_generator/Image/RawImageFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace wk::AtlasGenerator {
+    namespace {
+        constexpr char Magic[4] = {'A', 'G', 'R', 'C'};
+
+        // Smallest stored sizes of records, counts read from file are checked by them before allocation
+        constexpr uint64_t ImageHeaderSize = 6;
+        constexpr uint64_t VertexSize = 12;
+        constexpr uint64_t TransformSize = 16;
+        constexpr uint64_t PartSize = 4 + 4 + TransformSize;
+        constexpr uint64_t LayoutSize = PartSize + 4;
+
+        class Writer {
+        public:
+            Writer(std::ofstream& stream) :
+                m_stream(stream) {
+            }
+
+            template <typename T>
+            void write(T value) {
+                m_stream.write((const char*) &value, sizeof(T));
+            }
+
+            void write(const RawImage& image) {
+                write<uint16_t>(image.width());
+                write<uint16_t>(image.height());
+                write<uint8_t>((uint8_t) image.depth());
+                write<uint8_t>((uint8_t) image.colorspace());
+                m_stream.write((const char*) image.data(), image.data_length());
+            }
+
+            void write(const Container<Vertex>& vertices, const Item::Transformation<int32_t>& transform) {
+                write<uint32_t>((uint32_t) vertices.size());
+                for (const Vertex& vertex : vertices) {
+                    write<uint16_t>(vertex.uv.x);
+                    write<uint16_t>(vertex.uv.y);
+                    write<int32_t>(vertex.xy.x);
+                    write<int32_t>(vertex.xy.y);
+                }
+
+                write<double>(transform.rotation);
+                write<int32_t>(transform.translation.x);
+                write<int32_t>(transform.translation.y);
+            }
+
+        private:
+            std::ofstream& m_stream;
+        };
+
+        // Reads values while they fit into rest of file. Any malformed value fails reader
+        class Reader {
+        public:
+            Reader(std::ifstream& stream, uint64_t size) :
+                m_stream(stream),
+                m_remaining(size) {
+            }
+
+            template <typename T>
+            T read() {
+                T value{};
+                if (!take(sizeof(T)))
+                    return value;
+
+                m_stream.read((char*) &value, sizeof(T));
+                return value;
+            }
+
+            // Checks that count of records of provided minimal size fits into rest of file
+            bool fits(uint64_t count, uint64_t record_size) {
+                if (count > m_remaining / record_size) {
+                    m_failed = true;
+                }
+
+                return good();
+            }
+
+            bool read(Container<RawImage>& images) {
+                const uint16_t width = read<uint16_t>();
+                const uint16_t height = read<uint16_t>();
+                const uint8_t depth = read<uint8_t>();
+                const uint8_t colorspace = read<uint8_t>();
+
+                const uint8_t pixel_size = stored_pixel_size(depth);
+                if (!pixel_size || !is_stored_colorspace(colorspace)) {
+                    m_failed = true;
+                }
+
+                const uint64_t length = (uint64_t) width * height * pixel_size;
+                if (!good() || !take(length))
+                    return false;
+
+                RawImage& image =
+                    images.emplace_back(width, height, (Image::PixelDepth) depth, (Image::ColorSpace) colorspace);
+                m_stream.read((char*) image.data(), image.data_length());
+                return good();
+            }
+
+            bool read(Container<Vertex>& vertices, Item::Transformation<int32_t>& transform) {
+                const uint32_t count = read<uint32_t>();
+                if (!fits(count, VertexSize))
+                    return false;
+
+                vertices.resize(count);
+                for (Vertex& vertex : vertices) {
+                    vertex.uv.x = read<uint16_t>();
+                    vertex.uv.y = read<uint16_t>();
+                    vertex.xy.x = read<int32_t>();
+                    vertex.xy.y = read<int32_t>();
+                }
+
+                transform.rotation = read<double>();
+                transform.translation.x = read<int32_t>();
+                transform.translation.y = read<int32_t>();
+                return good();
+            }
+
+            bool good() const { return !m_failed && m_stream.good(); };
+
+        private:
+            bool take(uint64_t length) {
+                if (m_failed || length > m_remaining) {
+                    m_failed = true;
+                    return false;
+                }
+
+                m_remaining -= length;
+                return true;
+            }
+
+        private:
+            std::ifstream& m_stream;
+            uint64_t m_remaining;
+            bool m_failed = false;
+        };
+    }
+
+    ResultCache::ResultCache(const std::filesystem::path& directory) :
+        m_directory(directory) {
+        std::filesystem::create_directories(m_directory);
+    }
+
+    bool ResultCache::load(const Hash128& key, size_t item_count, size_t level_count, Entry& entry) const {
+        std::error_code error;
+        const uint64_t size = std::filesystem::file_size(path(key), error);
+        if (error)
+            return false;
+
+        std::ifstream stream(path(key), std::ios::binary);
+        if (!stream)
+            return false;
+
+        Reader reader(stream, size);
+
+        char magic[4] = {};
+        for (char& value : magic) {
+            value = reader.read<char>();
+        }
+        if (!std::equal(std::begin(magic), std::end(magic), std::begin(Magic)) || reader.read<uint32_t>() != Version)
+            return false;
+
+        // Entry of other run or damaged entry is a miss
+        const uint32_t atlas_count = reader.read<uint32_t>();
+        if (reader.read<uint32_t>() != level_count || reader.read<uint32_t>() != item_count)
+            return false;
+
+        if (!reader.fits((uint64_t) atlas_count * (level_count + 1), ImageHeaderSize) ||
+            !reader.fits(item_count, LayoutSize))
+            return false;
+
+        entry.atlases.reserve(atlas_count);
+        for (uint32_t i = 0; atlas_count > i; i++) {
+            if (!reader.read(entry.atlases))
+                return false;
+        }
+
+        entry.scaled_atlases.resize(level_count);
+        for (Container<RawImage>& level : entry.scaled_atlases) {
+            level.reserve(atlas_count);
+            for (uint32_t i = 0; atlas_count > i; i++) {
+                if (!reader.read(level))
+                    return false;
+            }
+        }
+
+        entry.items.resize(item_count);
+        for (Layout& layout : entry.items) {
+            layout.texture_index = reader.read<uint32_t>();
+            if (!reader.read(layout.vertices, layout.transform))
+                return false;
+
+            const uint32_t part_count = reader.read<uint32_t>();
+            if (!reader.fits(part_count, PartSize))
+                return false;
+
+            layout.parts.resize(part_count);
+            for (Item::Part& part : layout.parts) {
+                part.texture_index = reader.read<uint32_t>();
+                if (!reader.read(part.vertices, part.transform))
+                    return false;
+            }
+        }
+
+        return reader.good();
+    }
+
+    void ResultCache::store(const Hash128& key, const Entry& entry) {
+        std::filesystem::path destination = path(key);
+
+        // Each thread writes its own temporary file
+        std::stringstream suffix;
+        suffix << ".tmp" << std::this_thread::get_id();
+        std::filesystem::path temporary = std::filesystem::path(destination).concat(suffix.str());
+
+        {
+            std::ofstream stream(temporary, std::ios::binary);
+            Writer writer(stream);
+
+            stream.write(Magic, sizeof(Magic));
+            writer.write<uint32_t>(Version);
+            writer.write<uint32_t>((uint32_t) entry.atlases.size());
+            writer.write<uint32_t>((uint32_t) entry.scaled_atlases.size());
+            writer.write<uint32_t>((uint32_t) entry.items.size());
+
+            for (const RawImage& atlas : entry.atlases) {
+                writer.write(atlas);
+            }
+
+            for (const Container<RawImage>& level : entry.scaled_atlases) {
+                for (const RawImage& atlas : level) {
+                    writer.write(atlas);
+                }
+            }
+
+            for (const Layout& layout : entry.items) {
+                writer.write<uint32_t>((uint32_t) layout.texture_index);
+                writer.write(layout.vertices, layout.transform);
+
+                writer.write<uint32_t>((uint32_t) layout.parts.size());
+                for (const Item::Part& part : layout.parts) {
+                    writer.write<uint32_t>((uint32_t) part.texture_index);
+                    writer.write(part.vertices, part.transform);
+                }
+            }
+        }
+
+        std::lock_guard lock(m_mutex);
+        std::error_code error;
+        std::filesystem::rename(temporary, destination, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+
+    std::filesystem::path ResultCache::path(const Hash128& key) const {
+        return m_directory / (key.hex() + ".bin");
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "atlas_generator/Item/Item.h"
+
+#include <filesystem>
+#include <mutex>
+
+namespace wk::AtlasGenerator {
+    // Storage of whole generation results on disk, addressed by hash of inputs and config
+    class ResultCache {
+    public:
+        // Packing result of one item
+        struct Layout {
+            size_t texture_index = 0xFF;
+            Container<Vertex> vertices;
+            Item::Transformation<int32_t> transform;
+            Container<Item::Part> parts;
+        };
+
+        struct Entry {
+            Container<RawImage> atlases;
+            Container<Container<RawImage>> scaled_atlases;
+
+            // Texture indices are relative to first atlas of entry
+            Container<Layout> items;
+        };
+
+        // Version of stored data, changes of generator output must increment it
+        static constexpr uint32_t Version = 3;
+
+    public:
+        /// @param directory Folder with stored results. Created if it does not exist
+        ResultCache(const std::filesystem::path& directory);
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+    public:
+        /// @brief Loads stored result. Every count is checked against file size before it is used
+        /// @param item_count Expected count of item layouts
+        /// @param level_count Expected count of scaled atlas sets
+        /// @return False if there is no result with provided key, it is damaged or was stored for other input
+        bool load(const Hash128& key, size_t item_count, size_t level_count, Entry& entry) const;
+
+        /// @brief Stores result. Write is atomic, so concurrent readers never see partial result
+        void store(const Hash128& key, const Entry& entry);
+
+        const std::filesystem::path& directory() const { return m_directory; };
+
+    private:
+        std::filesystem::path path(const Hash128& key) const;
+
+    private:
+        std::filesystem::path m_directory;
+        std::mutex m_mutex;
+    };
+}
@@ -0,0 +1,750 @@
+#include "BlockEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace wk::AtlasGenerator {
+    namespace {
+        constexpr size_t BlockPixelCount = BlockDimension * BlockDimension;
+
+        using Pixel = std::array<uint8_t, 4>;
+        using Block = std::array<Pixel, BlockPixelCount>;
+
+        template <typename T>
+        T clamp_channel(T value) {
+            return std::clamp<T>(value, 0, 255);
+        }
+
+        // Reads block of pixels as RGBA, pixels outside of image are clamped to edge
+        void read_block(const RawImage& image, uint32_t block_x, uint32_t block_y, Block& block) {
+            const uint8_t channels = image.channels();
+
+            for (uint32_t y = 0; BlockDimension > y; y++) {
+                for (uint32_t x = 0; BlockDimension > x; x++) {
+                    uint16_t w = (uint16_t) std::min<uint32_t>(block_x * BlockDimension + x, image.width() - 1u);
+                    uint16_t h = (uint16_t) std::min<uint32_t>(block_y * BlockDimension + y, image.height() - 1u);
+
+                    const uint8_t* src = image.at(w, h);
+                    Pixel& pixel = block[y * BlockDimension + x];
+
+                    switch (channels) {
+                        case 4:
+                            pixel = {src[0], src[1], src[2], src[3]};
+                            break;
+                        case 3:
+                            pixel = {src[0], src[1], src[2], 255};
+                            break;
+                        case 2:
+                            pixel = {src[0], src[0], src[0], src[1]};
+                            break;
+                        default:
+                            pixel = {src[0], src[0], src[0], 255};
+                            break;
+                    }
+                }
+            }
+        }
+
+        // Principal axis of block colors by power iteration
+        template <size_t Channels>
+        void principal_axis(const Block& block, std::array<float, Channels>& mean, std::array<float, Channels>& axis) {
+            mean.fill(0.0f);
+            for (const Pixel& pixel : block) {
+                for (size_t c = 0; Channels > c; c++) {
+                    mean[c] += pixel[c];
+                }
+            }
+
+            for (float& value : mean) {
+                value /= BlockPixelCount;
+            }
+
+            std::array<std::array<float, Channels>, Channels> covariance = {};
+            for (const Pixel& pixel : block) {
+                for (size_t i = 0; Channels > i; i++) {
+                    for (size_t j = 0; Channels > j; j++) {
+                        covariance[i][j] += (pixel[i] - mean[i]) * (pixel[j] - mean[j]);
+                    }
+                }
+            }
+
+            axis.fill(1.0f);
+            for (size_t iteration = 0; 8 > iteration; iteration++) {
+                std::array<float, Channels> next = {};
+                for (size_t i = 0; Channels > i; i++) {
+                    for (size_t j = 0; Channels > j; j++) {
+                        next[i] += covariance[i][j] * axis[j];
+                    }
+                }
+
+                float length = 0.0f;
+                for (float value : next) {
+                    length += value * value;
+                }
+
+                if (std::numeric_limits<float>::epsilon() > length) {
+                    axis.fill(0.0f);
+                    return;
+                }
+
+                length = std::sqrt(length);
+                for (size_t i = 0; Channels > i; i++) {
+                    axis[i] = next[i] / length;
+                }
+            }
+        }
+
+        template <size_t Channels>
+        uint32_t pixel_error(const Pixel& a, const std::array<int32_t, 4>& b) {
+            uint32_t error = 0;
+            for (size_t c = 0; Channels > c; c++) {
+                int32_t difference = (int32_t) a[c] - b[c];
+                error += (uint32_t) (difference * difference);
+            }
+
+            return error;
+        }
+
+        void write_le(uint8_t* output, uint64_t value, size_t bytes) {
+            for (size_t i = 0; bytes > i; i++) {
+                output[i] = (uint8_t) (value >> (i * 8));
+            }
+        }
+
+        void write_be(uint8_t* output, uint64_t value) {
+            for (size_t i = 0; 8 > i; i++) {
+                output[i] = (uint8_t) (value >> ((7 - i) * 8));
+            }
+        }
+
+#pragma region BC1 / BC3
+
+        uint16_t pack_565(const std::array<float, 3>& color) {
+            uint16_t r = (uint16_t) std::lround(clamp_channel(color[0]) * 31.0f / 255.0f);
+            uint16_t g = (uint16_t) std::lround(clamp_channel(color[1]) * 63.0f / 255.0f);
+            uint16_t b = (uint16_t) std::lround(clamp_channel(color[2]) * 31.0f / 255.0f);
+
+            return (uint16_t) ((r << 11) | (g << 5) | b);
+        }
+
+        std::array<int32_t, 4> unpack_565(uint16_t color) {
+            int32_t r = (color >> 11) & 0x1F;
+            int32_t g = (color >> 5) & 0x3F;
+            int32_t b = color & 0x1F;
+
+            return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+        }
+
+        // Alpha threshold of BC1 punch-through mode
+        constexpr uint8_t PunchThroughAlpha = 128;
+
+        // Pixels below threshold are decoded as transparent black by index 3 of three color mode.
+        // Color endpoints are fitted to opaque pixels only
+        void encode_bc1_punch_through(const Block& block, uint8_t* output) {
+            std::array<float, 3> opaque_sum = {};
+            size_t opaque_count = 0;
+            for (const Pixel& pixel : block) {
+                if (pixel[3] >= PunchThroughAlpha) {
+                    for (size_t c = 0; 3 > c; c++) {
+                        opaque_sum[c] += pixel[c];
+                    }
+                    opaque_count++;
+                }
+            }
+
+            if (!opaque_count) {
+                write_le(output, 0, 4);
+                write_le(output + 4, 0xFFFFFFFF, 4);
+                return;
+            }
+
+            // Transparent pixels are replaced by mean of opaque ones, so they do not move mean and principal axis
+            Block opaque = block;
+            for (Pixel& pixel : opaque) {
+                if (PunchThroughAlpha > pixel[3]) {
+                    for (size_t c = 0; 3 > c; c++) {
+                        pixel[c] = (uint8_t) std::lround(opaque_sum[c] / opaque_count);
+                    }
+                }
+            }
+
+            std::array<float, 3> mean;
+            std::array<float, 3> axis;
+            principal_axis<3>(opaque, mean, axis);
+
+            float min_projection = std::numeric_limits<float>::max();
+            float max_projection = std::numeric_limits<float>::lowest();
+            for (const Pixel& pixel : opaque) {
+                float projection = 0.0f;
+                for (size_t c = 0; 3 > c; c++) {
+                    projection += (pixel[c] - mean[c]) * axis[c];
+                }
+
+                min_projection = std::min(min_projection, projection);
+                max_projection = std::max(max_projection, projection);
+            }
+
+            std::array<float, 3> low;
+            std::array<float, 3> high;
+            for (size_t c = 0; 3 > c; c++) {
+                low[c] = mean[c] + axis[c] * min_projection;
+                high[c] = mean[c] + axis[c] * max_projection;
+            }
+
+            // Three color mode is selected by color0 <= color1
+            uint16_t color0 = pack_565(low);
+            uint16_t color1 = pack_565(high);
+            if (color0 > color1) {
+                std::swap(color0, color1);
+            }
+
+            std::array<std::array<int32_t, 4>, 3> palette;
+            palette[0] = unpack_565(color0);
+            palette[1] = unpack_565(color1);
+            for (size_t c = 0; 3 > c; c++) {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            }
+
+            uint32_t indices = 0;
+            for (size_t i = 0; BlockPixelCount > i; i++) {
+                uint32_t best_index = 3;
+                if (block[i][3] >= PunchThroughAlpha) {
+                    uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                    for (uint32_t index = 0; palette.size() > index; index++) {
+                        uint32_t error = pixel_error<3>(block[i], palette[index]);
+                        if (best_error > error) {
+                            best_error = error;
+                            best_index = index;
+                        }
+                    }
+                }
+
+                indices |= best_index << (i * 2);
+            }
+
+            write_le(output, color0, 2);
+            write_le(output + 2, color1, 2);
+            write_le(output + 4, indices, 4);
+        }
+
+        void encode_bc1_color(const Block& block, uint8_t* output) {
+            std::array<float, 3> mean;
+            std::array<float, 3> axis;
+            principal_axis<3>(block, mean, axis);
+
+            float min_projection = std::numeric_limits<float>::max();
+            float max_projection = std::numeric_limits<float>::lowest();
+            for (const Pixel& pixel : block) {
+                float projection = 0.0f;
+                for (size_t c = 0; 3 > c; c++) {
+                    projection += (pixel[c] - mean[c]) * axis[c];
+                }
+
+                min_projection = std::min(min_projection, projection);
+                max_projection = std::max(max_projection, projection);
+            }
+
+            std::array<float, 3> low;
+            std::array<float, 3> high;
+            for (size_t c = 0; 3 > c; c++) {
+                low[c] = mean[c] + axis[c] * min_projection;
+                high[c] = mean[c] + axis[c] * max_projection;
+            }
+
+            uint16_t color0 = pack_565(high);
+            uint16_t color1 = pack_565(low);
+            if (color1 > color0) {
+                std::swap(color0, color1);
+            }
+
+            uint32_t indices = 0;
+            if (color0 != color1) {
+                std::array<std::array<int32_t, 4>, 4> palette;
+                palette[0] = unpack_565(color0);
+                palette[1] = unpack_565(color1);
+                for (size_t c = 0; 3 > c; c++) {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                }
+
+                for (size_t i = 0; BlockPixelCount > i; i++) {
+                    uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                    uint32_t best_index = 0;
+                    for (uint32_t index = 0; palette.size() > index; index++) {
+                        uint32_t error = pixel_error<3>(block[i], palette[index]);
+                        if (best_error > error) {
+                            best_error = error;
+                            best_index = index;
+                        }
+                    }
+
+                    indices |= best_index << (i * 2);
+                }
+            }
+
+            write_le(output, color0, 2);
+            write_le(output + 2, color1, 2);
+            write_le(output + 4, indices, 4);
+        }
+
+        void encode_bc4_alpha(const Block& block, uint8_t* output) {
+            uint8_t alpha0 = 0;
+            uint8_t alpha1 = 255;
+            for (const Pixel& pixel : block) {
+                alpha0 = std::max(alpha0, pixel[3]);
+                alpha1 = std::min(alpha1, pixel[3]);
+            }
+
+            uint64_t indices = 0;
+            if (alpha0 != alpha1) {
+                std::array<int32_t, 8> palette;
+                palette[0] = alpha0;
+                palette[1] = alpha1;
+                for (int32_t i = 1; 7 > i; i++) {
+                    palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+                }
+
+                for (size_t i = 0; BlockPixelCount > i; i++) {
+                    int32_t best_error = std::numeric_limits<int32_t>::max();
+                    uint64_t best_index = 0;
+                    for (uint64_t index = 0; palette.size() > index; index++) {
+                        int32_t error = std::abs(palette[index] - block[i][3]);
+                        if (best_error > error) {
+                            best_error = error;
+                            best_index = index;
+                        }
+                    }
+
+                    indices |= best_index << (i * 3);
+                }
+            }
+
+            output[0] = alpha0;
+            output[1] = alpha1;
+            write_le(output + 2, indices, 6);
+        }
+
+#pragma endregion
+
+#pragma region BC7
+
+        class BitWriter {
+        public:
+            void write(uint64_t value, uint32_t count) {
+                for (uint32_t i = 0; count > i; i++, m_position++) {
+                    uint64_t bit = (value >> i) & 1;
+                    if (64 > m_position) {
+                        m_low |= bit << m_position;
+                    } else {
+                        m_high |= bit << (m_position - 64);
+                    }
+                }
+            }
+
+            void flush(uint8_t* output) const {
+                write_le(output, m_low, 8);
+                write_le(output + 8, m_high, 8);
+            }
+
+        private:
+            uint64_t m_low = 0;
+            uint64_t m_high = 0;
+            uint32_t m_position = 0;
+        };
+
+        // Mode 6: single subset, RGBA endpoints with 7 bits and unique p-bit, 4 bit indices
+        void encode_bc7_mode6(const Block& block, uint8_t* output) {
+            constexpr std::array<int32_t, 16> weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+            std::array<float, 4> mean;
+            std::array<float, 4> axis;
+            principal_axis<4>(block, mean, axis);
+
+            float min_projection = std::numeric_limits<float>::max();
+            float max_projection = std::numeric_limits<float>::lowest();
+            for (const Pixel& pixel : block) {
+                float projection = 0.0f;
+                for (size_t c = 0; 4 > c; c++) {
+                    projection += (pixel[c] - mean[c]) * axis[c];
+                }
+
+                min_projection = std::min(min_projection, projection);
+                max_projection = std::max(max_projection, projection);
+            }
+
+            // Quantized endpoints and their p-bits
+            std::array<std::array<int32_t, 4>, 2> endpoints;
+            std::array<int32_t, 2> pbits;
+            for (size_t e = 0; 2 > e; e++) {
+                float projection = e == 0 ? min_projection : max_projection;
+
+                uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                for (int32_t pbit = 0; 2 > pbit; pbit++) {
+                    std::array<int32_t, 4> quantized;
+                    uint32_t error = 0;
+                    for (size_t c = 0; 4 > c; c++) {
+                        float value = clamp_channel(mean[c] + axis[c] * projection);
+                        quantized[c] = std::clamp<int32_t>((int32_t) std::lround((value - pbit) / 2.0f), 0, 127);
+
+                        int32_t difference = ((quantized[c] << 1) | pbit) - (int32_t) std::lround(value);
+                        error += (uint32_t) (difference * difference);
+                    }
+
+                    if (best_error > error) {
+                        best_error = error;
+                        endpoints[e] = quantized;
+                        pbits[e] = pbit;
+                    }
+                }
+            }
+
+            std::array<std::array<int32_t, 4>, 16> palette;
+            for (size_t i = 0; palette.size() > i; i++) {
+                for (size_t c = 0; 4 > c; c++) {
+                    int32_t value0 = (endpoints[0][c] << 1) | pbits[0];
+                    int32_t value1 = (endpoints[1][c] << 1) | pbits[1];
+                    palette[i][c] = ((64 - weights[i]) * value0 + weights[i] * value1 + 32) >> 6;
+                }
+            }
+
+            std::array<uint32_t, BlockPixelCount> indices;
+            for (size_t i = 0; BlockPixelCount > i; i++) {
+                uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                for (uint32_t index = 0; palette.size() > index; index++) {
+                    uint32_t error = pixel_error<4>(block[i], palette[index]);
+                    if (best_error > error) {
+                        best_error = error;
+                        indices[i] = index;
+                    }
+                }
+            }
+
+            // Most significant bit of first index is implicit zero
+            if (indices[0] & 8) {
+                std::swap(endpoints[0], endpoints[1]);
+                std::swap(pbits[0], pbits[1]);
+                for (uint32_t& index : indices) {
+                    index = 15 - index;
+                }
+            }
+
+            BitWriter writer;
+            writer.write(1 << 6, 7);
+            for (size_t c = 0; 4 > c; c++) {
+                writer.write((uint64_t) endpoints[0][c], 7);
+                writer.write((uint64_t) endpoints[1][c], 7);
+            }
+            writer.write((uint64_t) pbits[0], 1);
+            writer.write((uint64_t) pbits[1], 1);
+            for (size_t i = 0; BlockPixelCount > i; i++) {
+                writer.write(indices[i], i == 0 ? 3 : 4);
+            }
+
+            writer.flush(output);
+        }
+
+#pragma endregion
+
+#pragma region ETC2
+
+        constexpr int32_t EtcModifiers[8][2] = {
+            {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+        constexpr int32_t EacModifiers[16][8] = {{-3, -6, -9, -15, 2, 5, 8, 14},
+                                                 {-3, -7, -10, -13, 2, 6, 9, 12},
+                                                 {-2, -5, -8, -13, 1, 4, 7, 12},
+                                                 {-2, -4, -6, -13, 1, 3, 5, 12},
+                                                 {-3, -6, -8, -12, 2, 5, 7, 11},
+                                                 {-3, -7, -9, -11, 2, 6, 8, 10},
+                                                 {-4, -7, -8, -11, 3, 6, 7, 10},
+                                                 {-3, -5, -8, -11, 2, 4, 7, 10},
+                                                 {-2, -6, -8, -10, 1, 5, 7, 9},
+                                                 {-2, -5, -8, -10, 1, 4, 7, 9},
+                                                 {-2, -4, -8, -10, 1, 3, 7, 9},
+                                                 {-2, -5, -7, -10, 1, 4, 6, 9},
+                                                 {-3, -4, -7, -10, 2, 3, 6, 9},
+                                                 {-1, -2, -3, -10, 0, 1, 2, 9},
+                                                 {-4, -6, -8, -9, 3, 5, 7, 8},
+                                                 {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+        struct EtcSubblock {
+            uint32_t error = std::numeric_limits<uint32_t>::max();
+            uint32_t table = 0;
+            std::array<uint32_t, 8> indices = {};
+        };
+
+        // Converts pixel index in ETC order (column by column) to index in block (row by row)
+        uint32_t etc_to_linear(uint32_t position) {
+            return (position % BlockDimension) * BlockDimension + position / BlockDimension;
+        }
+
+        // Pixel indices of subblock in ETC pixel order
+        std::array<uint32_t, 8> etc_subblock_pixels(bool flip, uint32_t subblock) {
+            std::array<uint32_t, 8> result;
+            size_t i = 0;
+            for (uint32_t x = 0; BlockDimension > x; x++) {
+                for (uint32_t y = 0; BlockDimension > y; y++) {
+                    uint32_t position = flip ? y : x;
+                    if (position / 2 == subblock) {
+                        result[i++] = x * BlockDimension + y;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        EtcSubblock encode_etc_subblock(const Block& block,
+                                        const std::array<uint32_t, 8>& pixels,
+                                        const std::array<int32_t, 4>& base) {
+            EtcSubblock result;
+
+            for (uint32_t table = 0; 8 > table; table++) {
+                const int32_t modifiers[4] = {
+                    EtcModifiers[table][0], EtcModifiers[table][1], -EtcModifiers[table][0], -EtcModifiers[table][1]};
+
+                EtcSubblock candidate;
+                candidate.error = 0;
+                candidate.table = table;
+
+                for (size_t i = 0; pixels.size() > i; i++) {
+                    const Pixel& pixel = block[etc_to_linear(pixels[i])];
+
+                    uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                    for (uint32_t index = 0; 4 > index; index++) {
+                        std::array<int32_t, 4> color;
+                        for (size_t c = 0; 3 > c; c++) {
+                            color[c] = clamp_channel(base[c] + modifiers[index]);
+                        }
+
+                        uint32_t error = pixel_error<3>(pixel, color);
+                        if (best_error > error) {
+                            best_error = error;
+                            candidate.indices[i] = index;
+                        }
+                    }
+
+                    candidate.error += best_error;
+                }
+
+                if (result.error > candidate.error) {
+                    result = candidate;
+                }
+            }
+
+            return result;
+        }
+
+        void encode_etc2_rgb(const Block& block, uint8_t* output) {
+            uint64_t best_word = 0;
+            uint32_t best_error = std::numeric_limits<uint32_t>::max();
+
+            for (uint32_t flip = 0; 2 > flip; flip++) {
+                std::array<std::array<uint32_t, 8>, 2> pixels = {etc_subblock_pixels(flip, 0),
+                                                                 etc_subblock_pixels(flip, 1)};
+
+                std::array<std::array<float, 3>, 2> average = {};
+                for (size_t s = 0; 2 > s; s++) {
+                    for (uint32_t position : pixels[s]) {
+                        const Pixel& pixel = block[etc_to_linear(position)];
+                        for (size_t c = 0; 3 > c; c++) {
+                            average[s][c] += pixel[c] / 8.0f;
+                        }
+                    }
+                }
+
+                auto encode = [&](bool differential) {
+                    std::array<std::array<int32_t, 3>, 2> quantized;
+                    std::array<std::array<int32_t, 4>, 2> base;
+
+                    for (size_t s = 0; 2 > s; s++) {
+                        for (size_t c = 0; 3 > c; c++) {
+                            if (differential) {
+                                quantized[s][c] = (int32_t) std::lround(average[s][c] * 31.0f / 255.0f);
+                                base[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+                            } else {
+                                quantized[s][c] = (int32_t) std::lround(average[s][c] * 15.0f / 255.0f);
+                                base[s][c] = quantized[s][c] * 17;
+                            }
+                        }
+                    }
+
+                    if (differential) {
+                        for (size_t c = 0; 3 > c; c++) {
+                            int32_t delta = quantized[1][c] - quantized[0][c];
+                            if (-4 > delta || delta > 3)
+                                return;
+                        }
+                    }
+
+                    EtcSubblock first = encode_etc_subblock(block, pixels[0], base[0]);
+                    EtcSubblock second = encode_etc_subblock(block, pixels[1], base[1]);
+                    uint32_t error = first.error + second.error;
+                    if (error >= best_error)
+                        return;
+
+                    uint64_t word = 0;
+                    for (size_t c = 0; 3 > c; c++) {
+                        uint32_t shift = 56 - (uint32_t) c * 8;
+                        if (differential) {
+                            uint64_t delta = (uint64_t) ((quantized[1][c] - quantized[0][c]) & 0x7);
+                            word |= ((uint64_t) quantized[0][c] << (shift + 3)) | (delta << shift);
+                        } else {
+                            word |= ((uint64_t) quantized[0][c] << (shift + 4)) | ((uint64_t) quantized[1][c] << shift);
+                        }
+                    }
+
+                    word |= (uint64_t) first.table << 37;
+                    word |= (uint64_t) second.table << 34;
+                    word |= (uint64_t) differential << 33;
+                    word |= (uint64_t) flip << 32;
+
+                    for (size_t s = 0; 2 > s; s++) {
+                        const EtcSubblock& subblock = s == 0 ? first : second;
+                        for (size_t i = 0; pixels[s].size() > i; i++) {
+                            uint64_t index = subblock.indices[i];
+                            word |= ((index >> 1) & 1) << (pixels[s][i] + 16);
+                            word |= (index & 1) << pixels[s][i];
+                        }
+                    }
+
+                    best_error = error;
+                    best_word = word;
+                };
+
+                encode(true);
+                encode(false);
+            }
+
+            write_be(output, best_word);
+        }
+
+        void encode_eac_alpha(const Block& block, uint8_t* output) {
+            int32_t min_alpha = 255;
+            int32_t max_alpha = 0;
+            for (const Pixel& pixel : block) {
+                min_alpha = std::min<int32_t>(min_alpha, pixel[3]);
+                max_alpha = std::max<int32_t>(max_alpha, pixel[3]);
+            }
+
+            uint64_t best_word = 0;
+            uint32_t best_error = std::numeric_limits<uint32_t>::max();
+            const int32_t center = (min_alpha + max_alpha + 1) / 2;
+
+            for (uint32_t table = 0; 16 > table && best_error; table++) {
+                const int32_t* modifiers = EacModifiers[table];
+                const int32_t modifier_range = modifiers[7] - modifiers[3];
+
+                int32_t base_multiplier = std::max((max_alpha - min_alpha + modifier_range - 1) / modifier_range, 1);
+                for (int32_t multiplier = std::max(base_multiplier - 1, 1);
+                     std::min(base_multiplier + 1, 15) >= multiplier;
+                     multiplier++) {
+                    for (int32_t base = std::max(center - 2, 0); std::min(center + 2, 255) >= base; base++) {
+                        uint64_t word = ((uint64_t) base << 56) | ((uint64_t) multiplier << 52) |
+                                        ((uint64_t) table << 48);
+                        uint32_t error = 0;
+
+                        for (uint32_t x = 0; BlockDimension > x; x++) {
+                            for (uint32_t y = 0; BlockDimension > y; y++) {
+                                const int32_t alpha = block[y * BlockDimension + x][3];
+
+                                uint32_t best_pixel_error = std::numeric_limits<uint32_t>::max();
+                                uint64_t best_index = 0;
+                                for (uint64_t index = 0; 8 > index; index++) {
+                                    int32_t value = clamp_channel(base + modifiers[index] * multiplier);
+                                    uint32_t pixel_error = (uint32_t) ((value - alpha) * (value - alpha));
+                                    if (best_pixel_error > pixel_error) {
+                                        best_pixel_error = pixel_error;
+                                        best_index = index;
+                                    }
+                                }
+
+                                error += best_pixel_error;
+                                word |= best_index << (45 - (x * BlockDimension + y) * 3);
+                            }
+                        }
+
+                        if (best_error > error) {
+                            best_error = error;
+                            best_word = word;
+                        }
+                    }
+                }
+            }
+
+            write_be(output, best_word);
+        }
+
+#pragma endregion
+
+        void encode_block(const Block& block, BlockFormat format, uint8_t* output) {
+            switch (format) {
+                case BlockFormat::BC1: {
+                    bool transparent = std::any_of(block.begin(), block.end(), [](const Pixel& pixel) {
+                        return PunchThroughAlpha > pixel[3];
+                    });
+
+                    if (transparent) {
+                        encode_bc1_punch_through(block, output);
+                    } else {
+                        encode_bc1_color(block, output);
+                    }
+                } break;
+                case BlockFormat::BC3:
+                    encode_bc4_alpha(block, output);
+                    encode_bc1_color(block, output + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encode_bc7_mode6(block, output);
+                    break;
+                case BlockFormat::ETC2_RGB:
+                    encode_etc2_rgb(block, output);
+                    break;
+                case BlockFormat::ETC2_RGBA:
+                    encode_eac_alpha(block, output);
+                    encode_etc2_rgb(block, output + 8);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    size_t block_format_size(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1:
+            case BlockFormat::ETC2_RGB:
+                return 8;
+            default:
+                return 16;
+        }
+    }
+
+    bool can_encode_blocks(const RawImage& image) {
+        return !image.is_complex() && image.pixel_size() == image.channels();
+    }
+
+    void encode_blocks(const RawImage& image, BlockFormat format, std::vector<uint8_t>& output, ThreadPool& pool) {
+        const uint32_t blocks_x = (image.width() + BlockDimension - 1) / BlockDimension;
+        const uint32_t blocks_y = (image.height() + BlockDimension - 1) / BlockDimension;
+        const size_t block_size = block_format_size(format);
+
+        output.resize((size_t) blocks_x * blocks_y * block_size);
+
+        std::vector<uint32_t> rows(blocks_y);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        pool.enumerate(rows.begin(), rows.end(), [&](uint32_t row, size_t) {
+            Block block;
+            uint8_t* destination = output.data() + (size_t) row * blocks_x * block_size;
+
+            for (uint32_t column = 0; blocks_x > column; column++) {
+                read_block(image, column, row, block);
+                encode_block(block, format, destination + (size_t) column * block_size);
+            }
+        });
+    }
+}
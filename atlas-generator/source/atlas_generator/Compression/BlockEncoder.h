@@ -0,0 +1,34 @@
+#pragma once
+
+#include "atlas_generator/Threading/ThreadPool.h"
+#include "core/image/raw_image.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace wk::AtlasGenerator {
+    // GPU texture formats with 4x4 pixel blocks
+    enum class BlockFormat : uint8_t {
+        // Pixels with alpha below half are encoded by 1-bit punch-through alpha
+        BC1 = 0,
+        BC3,
+        BC7,
+        ETC2_RGB,
+        ETC2_RGBA
+    };
+
+    constexpr uint8_t BlockDimension = 4;
+
+    /// @brief Size of one encoded block in bytes
+    size_t block_format_size(BlockFormat format);
+
+    /// @brief Checks if image can be processed by block encoder
+    bool can_encode_blocks(const RawImage& image);
+
+    /// @brief Compresses image to provided block format. Rows of blocks are encoded in parallel
+    /// @param image Source image with 8 bits per channel
+    /// @param format Block format
+    /// @param output Encoded blocks, row by row
+    /// @param pool Thread pool for block rows
+    void encode_blocks(const RawImage& image, BlockFormat format, std::vector<uint8_t>& output, ThreadPool& pool);
+}
@@ -12,4 +12,86 @@ namespace wk::AtlasGenerator {
         m_parallel(parallel),
         m_alpha_threshold(alpha_threshold) {
     }
+
+    Config::Snapshot Config::snapshot() const {
+        return {width(), height(), scale(), extrude(), alpha_threshold(), block_size()};
+    }
+
+    void Config::set_split_islands(bool enabled, uint8_t distance) {
+        m_split_islands = enabled;
+        m_island_distance = std::clamp<uint8_t>(distance, MinIslandDistance, MaxIslandDistance);
+    }
+
+    void Config::set_split_oversized(bool enabled, uint8_t overlap) {
+        m_split_oversized = enabled;
+        m_tile_overlap = std::clamp<uint8_t>(overlap, MinTileOverlap, MaxTileOverlap);
+    }
+
+    void Config::set_scale_levels(const std::vector<float>& levels) {
+        m_scale_levels.clear();
+        for (float level : levels) {
+            m_scale_levels.push_back(std::clamp<float>(level, MinScaleLevel, MaxScaleLevel));
+        }
+
+        std::sort(m_scale_levels.begin(), m_scale_levels.end(), std::greater<float>());
+        m_scale_levels.erase(std::unique(m_scale_levels.begin(), m_scale_levels.end()), m_scale_levels.end());
+    }
+
+    void Config::set_block_size(uint8_t size) {
+        m_block_size = std::clamp<uint8_t>(size, MinBlockSize, MaxBlockSize);
+    }
+
+    void Config::set_page_optimization(bool minimize, PageConstraint constraint) {
+        m_minimize_pages = minimize;
+        m_page_constraint = constraint;
+    }
+
+    void Config::set_packing_preset(PackingPreset preset) {
+        switch (preset) {
+            case PackingPreset::Draft:
+                m_packing_accuracy = 0.2f;
+                m_packing_selection = PackingSelection::FirstFit;
+                m_packing_rotations = PackingRotations::None;
+                m_vertex_budget = MinVertexBudget;
+                m_packing_portfolio = false;
+                break;
+            case PackingPreset::Balanced:
+                m_packing_accuracy = 0.6f;
+                m_packing_selection = PackingSelection::FirstFit;
+                m_packing_rotations = PackingRotations::QuarterTurns;
+                m_vertex_budget = MaxVertexBudget;
+                m_packing_portfolio = false;
+                break;
+            case PackingPreset::MaxDensity:
+                m_packing_accuracy = 1.0f;
+                m_packing_selection = PackingSelection::DJD;
+                m_packing_rotations = PackingRotations::QuarterTurns;
+                m_vertex_budget = MaxVertexBudget;
+                m_packing_portfolio = true;
+                break;
+        }
+    }
+
+    void Config::set_packing_portfolio(bool enabled) {
+        m_packing_portfolio = enabled;
+    }
+
+    void Config::set_hierarchical_packing(bool enabled, uint16_t cluster_size) {
+        m_hierarchical_packing = enabled;
+        m_cluster_size = std::clamp<uint16_t>(cluster_size, MinClusterSize, MaxClusterSize);
+    }
+
+    void Config::set_memory_budget(size_t bytes, const std::filesystem::path& scratch_directory) {
+        m_memory_budget = bytes;
+        m_scratch_directory = scratch_directory;
+    }
+
+    void Config::set_failure_policy(FailurePolicy policy) {
+        m_failure_policy = policy;
+    }
+
+    void Config::set_threads(uint16_t count, bool pin) {
+        m_threads = count;
+        m_pin_threads = pin;
+    }
 }
\ No newline at end of file
@@ -1,11 +1,65 @@
 #pragma once
 
+#include "Constants.h"
+
 #include <algorithm>
+#include <filesystem>
 #include <functional>
 #include <stdint.h>
+#include <vector>
 
 namespace wk::AtlasGenerator {
     class Config {
+    public:
+        // Restriction for final atlas dimensions
+        enum class PageConstraint : uint8_t {
+            None = 0,
+            MultipleOf4,
+            PowerOfTwo
+        };
+
+        // Named sets of packing parameters, from the fastest to the densest
+        enum class PackingPreset : uint8_t {
+            Draft = 0,
+            Balanced,
+            MaxDensity
+        };
+
+        // Heuristic that selects next item for placement
+        enum class PackingSelection : uint8_t {
+            FirstFit = 0,
+            DJD
+        };
+
+        // Rotations packer may apply to items
+        enum class PackingRotations : uint8_t {
+            None = 0,
+            HalfTurn,
+            QuarterTurns
+        };
+
+        // Handling of items that can not be packed
+        enum class FailurePolicy : uint8_t {
+            // Generation stops with exception on first failed item
+            Throw = 0,
+
+            // Failed items are not placed to atlas
+            Skip,
+
+            // Items without valid polygon are packed as rectangles, the rest of failed items are skipped
+            Rectangle
+        };
+
+        // Plain copy of parameters that are read in per-pixel loops, so hot loops make no virtual calls
+        struct Snapshot {
+            uint16_t width;
+            uint16_t height;
+            float scale;
+            uint8_t extrude;
+            uint8_t alpha_threshold;
+            uint8_t block_size;
+        };
+
     public:
         Config(uint16_t width,
                uint16_t height,
@@ -24,6 +78,105 @@ namespace wk::AtlasGenerator {
         virtual uint8_t alpha_threshold() const { return m_alpha_threshold; };
         // virtual bool try_use_gpu() const { return m_try_use_gpu; };
 
+        // Islands splitting
+        virtual bool split_islands() const { return m_split_islands; };
+        virtual uint8_t island_distance() const { return m_island_distance; };
+
+        // Tiling of images that are bigger than page
+        virtual bool split_oversized() const { return m_split_oversized; };
+        virtual uint8_t tile_overlap() const { return m_tile_overlap; };
+
+        // Multi-scale atlas set
+        virtual const std::vector<float>& scale_levels() const { return m_scale_levels; };
+
+        // Size of texture compression block items are aligned to. 1 means no alignment
+        virtual uint8_t block_size() const { return m_block_size; };
+
+        // Page size optimization
+        virtual bool minimize_pages() const { return m_minimize_pages; };
+        virtual PageConstraint page_constraint() const { return m_page_constraint; };
+
+        // Packing cost
+        virtual float packing_accuracy() const { return m_packing_accuracy; };
+        virtual PackingSelection packing_selection() const { return m_packing_selection; };
+        virtual PackingRotations packing_rotations() const { return m_packing_rotations; };
+        virtual uint8_t vertex_budget() const { return m_vertex_budget; };
+
+        // Packing with several strategies at once
+        virtual bool packing_portfolio() const { return m_packing_portfolio; };
+
+        // Packing of small items in clusters
+        virtual bool hierarchical_packing() const { return m_hierarchical_packing; };
+        virtual uint16_t cluster_size() const { return m_cluster_size; };
+
+        // Memory limit for item pixels and atlases. 0 means unlimited
+        virtual size_t memory_budget() const { return m_memory_budget; };
+        virtual const std::filesystem::path& scratch_directory() const { return m_scratch_directory; };
+
+        // Partial success mode
+        virtual FailurePolicy failure_policy() const { return m_failure_policy; };
+
+        // Threading
+        virtual uint16_t threads() const { return m_threads; };
+        virtual bool pin_threads() const { return m_pin_threads; };
+
+        /// @brief Reads current values of all getters used by pixel kernels
+        Snapshot snapshot() const;
+
+    public:
+        /// @brief Enables packing of separated opaque regions of one image as independent parts
+        /// @param distance Minimal distance in pixels between two regions to treat them as separate islands
+        void set_split_islands(bool enabled, uint8_t distance = DefaultIslandDistance);
+
+        /// @brief Splits images that do not fit into page into rectangular tiles that are packed as parts of image.
+        /// Each tile keeps its own extrusion
+        /// @param overlap Count of pixels around tile that are copied from neighbor tiles but not covered by polygon
+        void set_split_oversized(bool enabled, uint8_t overlap = DefaultTileOverlap);
+
+        /// @brief Sets scales of additional atlas sets that are downsampled from main atlases after packing
+        /// @param levels Scales relative to main atlases, e.g. 0.5 and 0.25
+        void set_scale_levels(const std::vector<float>& levels);
+
+        /// @brief Aligns items with their extrusion to grid of compression blocks,
+        /// so blocks of different items never overlap and no extra padding is needed.
+        /// Items are packed as their bounding rectangles in whole blocks, polygon nesting is not used,
+        /// so atlases are usually bigger than without alignment
+        /// @param size Block size in pixels, e.g. 4 for ETC2 and BC formats
+        void set_block_size(uint8_t size);
+
+        /// @brief Sets page size rules
+        /// @param minimize Repacks last page into the smallest box that fits its items
+        /// @param constraint Rule for atlas dimensions
+        void set_page_optimization(bool minimize, PageConstraint constraint = PageConstraint::None);
+
+        /// @brief Sets placer accuracy, rotations, polygon vertex budget, selection heuristic and portfolio together.
+        /// Draft packs rectangles without rotations, MaxDensity runs packing portfolio with the highest accuracy
+        void set_packing_preset(PackingPreset preset);
+
+        /// @brief Packs items with several selection heuristics, item orders, accuracies and starting points
+        /// in parallel and keeps layout with the fewest pages and the smallest total area
+        void set_packing_portfolio(bool enabled);
+
+        /// @brief Packs small items into rigid clusters first and then packs clusters with the rest of items.
+        /// Keeps packing time close to linear for huge item counts
+        /// @param cluster_size Count of items that are packed together into one or several clusters
+        void set_hierarchical_packing(bool enabled, uint16_t cluster_size = DefaultClusterSize);
+
+        /// @brief Limits memory used by item pixels and atlases.
+        /// Pixels of processed items are moved to scratch file when budget is exceeded and loaded back for blitting
+        /// @param bytes Budget in bytes, 0 means unlimited
+        /// @param scratch_directory Folder for scratch file, system temporary folder if empty
+        void set_memory_budget(size_t bytes, const std::filesystem::path& scratch_directory = {});
+
+        /// @brief Sets handling of items that can not be packed. With policies other than Throw
+        /// the rest of items are still packed and failures are collected by generator
+        void set_failure_policy(FailurePolicy policy);
+
+        /// @brief Sets size of generator thread pool
+        /// @param count Count of threads for all parallel stages. 0 means hardware concurrency
+        /// @param pin Binds pool threads to CPU cores
+        void set_threads(uint16_t count, bool pin = false);
+
     private:
         const uint16_t m_max_width;
         const uint16_t m_max_height;
@@ -33,6 +186,36 @@ namespace wk::AtlasGenerator {
         const uint8_t m_alpha_threshold;
         // const bool m_try_use_gpu = true;
 
+        bool m_split_islands = false;
+        uint8_t m_island_distance = DefaultIslandDistance;
+
+        bool m_split_oversized = false;
+        uint8_t m_tile_overlap = DefaultTileOverlap;
+
+        std::vector<float> m_scale_levels;
+
+        uint8_t m_block_size = MinBlockSize;
+
+        bool m_minimize_pages = false;
+        PageConstraint m_page_constraint = PageConstraint::None;
+
+        float m_packing_accuracy = 0.6f;
+        PackingSelection m_packing_selection = PackingSelection::FirstFit;
+        PackingRotations m_packing_rotations = PackingRotations::QuarterTurns;
+        uint8_t m_vertex_budget = MaxVertexBudget;
+        bool m_packing_portfolio = false;
+
+        bool m_hierarchical_packing = false;
+        uint16_t m_cluster_size = DefaultClusterSize;
+
+        size_t m_memory_budget = 0;
+        std::filesystem::path m_scratch_directory;
+
+        FailurePolicy m_failure_policy = FailurePolicy::Throw;
+
+        uint16_t m_threads = 0;
+        bool m_pin_threads = false;
+
     public:
         std::function<void(size_t)> progress;
     };
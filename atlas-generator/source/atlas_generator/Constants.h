@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace wk::AtlasGenerator {
@@ -11,4 +12,53 @@ namespace wk::AtlasGenerator {
 
     constexpr float MinScaleFactor = 0.25f;
     constexpr float MaxScaleFactor = 10.0f;
+
+    // Limits of additional atlas scales relative to main atlases
+    constexpr float MinScaleLevel = 0.0625f;
+    constexpr float MaxScaleLevel = 0.99f;
+
+    // Item polygon is a rectangle with up to 4 cut corners
+    constexpr uint8_t MinVertexBudget = 4;
+    constexpr uint8_t MaxVertexBudget = 8;
+
+    // Hierarchical packing clusters items that fit into this part of page by both sides
+    constexpr uint16_t ClusterItemDivisor = 8;
+    constexpr uint16_t MinClusterSize = 4;
+    constexpr uint16_t MaxClusterSize = 4096;
+    constexpr uint16_t DefaultClusterSize = 256;
+
+    // Expected part of cluster box covered by items
+    constexpr float ClusterFillRatio = 0.8f;
+
+    // Images with larger area take polygon hull from downsampled alpha mask first
+    constexpr size_t CoarseHullMinArea = 512 * 512;
+
+    // Side of mask block that is reduced to one texel of downsampled mask
+    constexpr int32_t CoarseHullBlockSize = 8;
+
+    // Size of one color cell in colorfill palette, in blocks of downsampling divisor.
+    // Cell of three blocks contains two aligned blocks wherever palette is placed
+    constexpr uint16_t PaletteCellSize = 3;
+
+    // Placement grid for block compressed textures
+    constexpr uint8_t MinBlockSize = 1;
+    constexpr uint8_t MaxBlockSize = 12;
+
+    constexpr uint8_t MinIslandDistance = 1;
+    constexpr uint8_t MaxIslandDistance = 64;
+    constexpr uint8_t DefaultIslandDistance = 8;
+
+    // Pixels shared by neighbor tiles of oversized image, so sampling at tile edges reads real neighbors
+    constexpr uint8_t MinTileOverlap = 0;
+    constexpr uint8_t MaxTileOverlap = 16;
+    constexpr uint8_t DefaultTileOverlap = 2;
+
+    // Polygons kept by shared polygon cache, the least recently used ones are evicted
+    constexpr size_t DefaultPolygonCacheCapacity = 65536;
+
+    // Images with more islands than that are packed as a whole
+    constexpr size_t MaxIslandCount = 64;
+
+    // Islands are used only when their bounds together take less than this part of image area
+    constexpr float IslandAreaRatio = 0.8f;
 }
@@ -1,18 +1,652 @@
 #include "Generator.h"
 
 #include "Constants.h"
+#include "Image/PixelKernels.h"
+#include "Image/Resample.h"
 
+#include <cstring>
 #include <libnest2d/libnest2d.hpp>
 
 namespace wk::AtlasGenerator {
-    Generator::Generator(const Config& config) :
-        m_config(config) {
+    namespace {
+        // Repacks items of bin into the smallest box that still fits all of them
+        template <typename NestConfig, typename PageArea>
+        void minimize_bin(std::vector<libnest2d::Item>& packer_items,
+                          int bin,
+                          libnest2d::Coord distance,
+                          const NestConfig& cfg,
+                          PageArea page_area,
+                          const libnest2d::NestControl& control,
+                          ThreadPool& pool) {
+            constexpr float factors[] = {1.0f, 0.95f, 0.9f, 0.85f, 0.8f, 0.75f, 0.7f, 0.6f, 0.5f};
+
+            std::vector<size_t> indices;
+            libnest2d::Coord used_width = 0;
+            libnest2d::Coord used_height = 0;
+            double items_area = 0.0;
+            for (size_t i = 0; packer_items.size() > i; i++) {
+                libnest2d::Item& item = packer_items[i];
+                if (item.binId() != bin)
+                    continue;
+
+                auto box = item.boundingBox();
+                used_width = std::max(used_width, libnest2d::getX(box.maxCorner()));
+                used_height = std::max(used_height, libnest2d::getY(box.maxCorner()));
+                items_area += std::abs(item.area());
+                indices.push_back(i);
+            }
+
+            if (indices.empty())
+                return;
+
+            const size_t used_area = page_area(used_width, used_height);
+
+            std::vector<std::pair<libnest2d::Coord, libnest2d::Coord>> candidates;
+            for (float width_factor : factors) {
+                for (float height_factor : factors) {
+                    auto width = (libnest2d::Coord) std::ceil(used_width * width_factor);
+                    auto height = (libnest2d::Coord) std::ceil(used_height * height_factor);
+
+                    if (items_area > (double) width * height || page_area(width, height) >= used_area)
+                        continue;
+
+                    candidates.emplace_back(width, height);
+                }
+            }
+
+            std::stable_sort(candidates.begin(), candidates.end(), [&page_area](const auto& a, const auto& b) {
+                return page_area(a.first, a.second) < page_area(b.first, b.second);
+            });
+
+            // Candidates are tested by groups from the smallest one, first group with fitting box wins
+            const size_t group_size = pool.thread_count();
+            for (size_t group = 0; candidates.size() > group; group += group_size) {
+                if (control.stopcond())
+                    return;
+
+                size_t group_end = std::min(group + group_size, candidates.size());
+
+                std::vector<std::future<std::optional<std::vector<libnest2d::Item>>>> results;
+                for (size_t c = group; group_end > c; c++) {
+                    auto [width, height] = candidates[c];
+
+                    results.push_back(pool.submit([&, width = width, height = height]() {
+                        std::vector<libnest2d::Item> items;
+                        items.reserve(indices.size());
+                        for (size_t index : indices) {
+                            libnest2d::Item& item = items.emplace_back(packer_items[index]);
+                            item.translation({0, 0});
+                            item.rotation(0.0);
+                            item.binId(libnest2d::BIN_ID_UNSET);
+                        }
+
+                        libnest2d::NestControl candidate_control;
+                        candidate_control.stopcond = control.stopcond;
+
+                        size_t bin_count = libnest2d::nest(items,
+                                                           libnest2d::Box(width, height, {width / 2, height / 2}),
+                                                           distance,
+                                                           cfg,
+                                                           candidate_control);
+
+                        std::optional<std::vector<libnest2d::Item>> result;
+                        if (bin_count == 1 && std::all_of(items.begin(), items.end(), [](const libnest2d::Item& item) {
+                                return item.binId() == 0;
+                            })) {
+                            result = std::move(items);
+                        }
+
+                        return result;
+                    }));
+                }
+
+                std::optional<std::vector<libnest2d::Item>> best;
+                if (control.stopcond())
+                    return;
+
+                for (auto& result : results) {
+                    auto items = pool.wait(result);
+                    if (!best.has_value() && items.has_value()) {
+                        best = std::move(items);
+                    }
+                }
+
+                if (best.has_value()) {
+                    for (size_t i = 0; indices.size() > i; i++) {
+                        libnest2d::Item& item = packer_items[indices[i]];
+                        item = best.value()[i];
+                        item.binId(bin);
+                    }
+
+                    return;
+                }
+            }
+        }
+
+        using Alignment = libnest2d::NestConfig<>::Placement::Alignment;
+
+        // Order in which items are offered to packer
+        enum class ItemOrder : uint8_t {
+            Area = 0,
+            Height,
+            Width,
+            Perimeter
+        };
+
+        struct PackingStrategy {
+            bool djd_selection;
+            ItemOrder order;
+            float accuracy;
+            Alignment starting_point;
+
+            bool operator==(const PackingStrategy& other) const {
+                return djd_selection == other.djd_selection && order == other.order && accuracy == other.accuracy &&
+                       starting_point == other.starting_point;
+            }
+        };
+
+        // Strategies that packing portfolio tries in addition to the configured one
+        const PackingStrategy PortfolioStrategies[] = {
+            {false, ItemOrder::Area, 0.6f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Height, 0.6f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Width, 0.6f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Perimeter, 0.6f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Area, 1.0f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Height, 1.0f, Alignment::BOTTOM_LEFT},
+            {false, ItemOrder::Area, 0.6f, Alignment::TOP_RIGHT},
+            {false, ItemOrder::Area, 0.6f, Alignment::CENTER},
+            {true, ItemOrder::Area, 0.6f, Alignment::BOTTOM_LEFT},
+        };
+
+        // Rotations that packer may apply, in radians
+        const double QuarterTurns[] = {0.0, libnest2d::Pi / 2.0, libnest2d::Pi, libnest2d::Pi * 3.0 / 2.0};
+
+        struct PackingResult {
+            std::vector<libnest2d::Item> items;
+            size_t bin_count = 0;
+            bool complete = false;
+            size_t area = 0;
+        };
+
+        template <typename Selection>
+        libnest2d::NestConfig<libnest2d::NfpPlacer, Selection> make_nest_config(const PackingStrategy& strategy,
+                                                                                Config::PackingRotations rotations) {
+            libnest2d::NestConfig<libnest2d::NfpPlacer, Selection> cfg;
+            cfg.placer_config.alignment = Alignment::DONT_ALIGN;
+            cfg.placer_config.starting_point = strategy.starting_point;
+            // Placer threads would run on top of pool that already has one worker per core,
+            // packing is parallelized by pool tasks instead
+            cfg.placer_config.parallel = false;
+            cfg.placer_config.accuracy = strategy.accuracy;
+
+            switch (rotations) {
+                case Config::PackingRotations::None:
+                    cfg.placer_config.rotations = {QuarterTurns[0]};
+                    break;
+                case Config::PackingRotations::HalfTurn:
+                    cfg.placer_config.rotations = {QuarterTurns[0], QuarterTurns[2]};
+                    break;
+                case Config::PackingRotations::QuarterTurns:
+                    cfg.placer_config.rotations = {QuarterTurns[0], QuarterTurns[1], QuarterTurns[2], QuarterTurns[3]};
+                    break;
+            }
+
+            if constexpr (std::is_same_v<Selection, libnest2d::FirstFitSelection>) {
+                cfg.selector_config.verify_items = false;
+            }
+
+            // DJD tries item pairs on its own threads otherwise
+            if constexpr (std::is_same_v<Selection, libnest2d::DJDHeuristic>) {
+                cfg.selector_config.allow_parallel = false;
+            }
+
+            return cfg;
+        }
+
+        // Packer takes items with higher priority first and sorts items by area inside of one priority,
+        // so other orders are passed as priorities
+        void apply_item_order(std::vector<libnest2d::Item>& items, ItemOrder order) {
+            if (order == ItemOrder::Area)
+                return;
+
+            std::vector<libnest2d::Coord> keys(items.size());
+            for (size_t i = 0; items.size() > i; i++) {
+                auto box = items[i].boundingBox();
+
+                switch (order) {
+                    case ItemOrder::Height:
+                        keys[i] = box.height();
+                        break;
+                    case ItemOrder::Width:
+                        keys[i] = box.width();
+                        break;
+                    default:
+                        keys[i] = (box.width() + box.height()) * 2;
+                        break;
+                }
+            }
+
+            std::vector<size_t> indices(items.size());
+            std::iota(indices.begin(), indices.end(), 0);
+            std::stable_sort(
+                indices.begin(), indices.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+            for (size_t rank = 0; indices.size() > rank; rank++) {
+                items[indices[rank]].priority((int) (indices.size() - rank));
+            }
+        }
+
+        // Moves items of each bin so their common bound starts at bin origin
+        void normalize_bins(std::vector<libnest2d::Item>& items, size_t bin_count) {
+            constexpr libnest2d::Coord unset = std::numeric_limits<libnest2d::Coord>::max();
+            std::vector<std::pair<libnest2d::Coord, libnest2d::Coord>> origins(bin_count, {unset, unset});
+
+            for (libnest2d::Item& item : items) {
+                auto box = item.boundingBox();
+                auto& origin = origins[item.binId()];
+
+                origin.first = std::min(origin.first, libnest2d::getX(box.minCorner()));
+                origin.second = std::min(origin.second, libnest2d::getY(box.minCorner()));
+            }
+
+            for (libnest2d::Item& item : items) {
+                const auto& origin = origins[item.binId()];
+                auto translation = item.translation();
+
+                item.translation(
+                    {libnest2d::getX(translation) - origin.first, libnest2d::getY(translation) - origin.second});
+            }
+        }
+
+        libnest2d::Item rectangle_item(libnest2d::Coord width, libnest2d::Coord height) {
+            return libnest2d::Item(
+                std::vector<libnest2d::Point>({{width, 0}, {width, height}, {0, height}, {0, 0}, {width, 0}}));
+        }
+
+        // Group of small items packed together and placed as one rigid rectangle
+        struct Cluster {
+            libnest2d::Item item = rectangle_item(0, 0);
+
+            // Indices of packer items and their placement relative to cluster origin
+            std::vector<size_t> children;
+            std::vector<libnest2d::Item> placements;
+        };
+
+        // Packs groups of similar small items into tight clusters in parallel.
+        // Items that didn't fit into cluster box become clusters on their own.
+        // Progress is reported from calling thread with count of items of each finished group
+        template <typename NestConfig>
+        std::vector<Cluster> build_clusters(const std::vector<libnest2d::Item>& packer_items,
+                                            std::vector<size_t> small_items,
+                                            size_t cluster_size,
+                                            libnest2d::Coord max_width,
+                                            libnest2d::Coord max_height,
+                                            libnest2d::Coord distance,
+                                            const NestConfig& cfg,
+                                            const libnest2d::NestControl& control,
+                                            const std::function<void(size_t)>& progress,
+                                            ThreadPool& pool) {
+            // Items of similar height are packed together with less waste
+            std::stable_sort(small_items.begin(), small_items.end(), [&packer_items](size_t a, size_t b) {
+                return packer_items[a].boundingBox().height() > packer_items[b].boundingBox().height();
+            });
+
+            std::vector<size_t> groups;
+            for (size_t offset = 0; small_items.size() > offset; offset += cluster_size) {
+                groups.push_back(offset);
+            }
+
+            // Group nests run on pool threads, so they get no progress function
+            libnest2d::NestControl group_control;
+            group_control.stopcond = control.stopcond;
+
+            std::vector<std::vector<Cluster>> results(groups.size());
+            auto build_group = [&](size_t offset, size_t group) {
+                if (control.stopcond())
+                    return;
+
+                const size_t end = std::min(offset + cluster_size, small_items.size());
+
+                std::vector<libnest2d::Item> items;
+                items.reserve(end - offset);
+                double items_area = 0.0;
+                libnest2d::Coord widest = 0;
+                libnest2d::Coord tallest = 0;
+                for (size_t i = offset; end > i; i++) {
+                    const libnest2d::Item& item = items.emplace_back(packer_items[small_items[i]]);
+
+                    auto box = item.boundingBox();
+                    items_area += (double) (box.width() + distance) * (box.height() + distance);
+                    widest = std::max(widest, box.width());
+                    tallest = std::max(tallest, box.height());
+                }
+
+                // Square box with some space for packing waste
+                auto side = (libnest2d::Coord) std::ceil(std::sqrt(items_area / ClusterFillRatio));
+                libnest2d::Coord width = std::clamp(side, widest, max_width);
+                libnest2d::Coord height = std::clamp(side, tallest, max_height);
+
+                const libnest2d::Box box(width, height, {width / 2, height / 2});
+                size_t bin_count = libnest2d::nest(items, box, distance, cfg, group_control);
+
+                std::vector<Cluster>& clusters = results[group];
+                clusters.resize(bin_count);
+                for (size_t i = 0; items.size() > i; i++) {
+                    libnest2d::Item& item = items[i];
+                    if (item.binId() == libnest2d::BIN_ID_UNSET) {
+                        item = packer_items[small_items[offset + i]];
+                        item.binId((int) clusters.size());
+                        clusters.emplace_back();
+                    }
+
+                    Cluster& cluster = clusters[item.binId()];
+                    cluster.children.push_back(small_items[offset + i]);
+                    cluster.placements.push_back(item);
+                }
+
+                for (Cluster& cluster : clusters) {
+                    constexpr libnest2d::Coord unset = std::numeric_limits<libnest2d::Coord>::max();
+                    libnest2d::Coord min_x = unset, min_y = unset, max_x = -unset, max_y = -unset;
+                    for (const libnest2d::Item& placement : cluster.placements) {
+                        auto box = placement.boundingBox();
+                        min_x = std::min(min_x, libnest2d::getX(box.minCorner()));
+                        min_y = std::min(min_y, libnest2d::getY(box.minCorner()));
+                        max_x = std::max(max_x, libnest2d::getX(box.maxCorner()));
+                        max_y = std::max(max_y, libnest2d::getY(box.maxCorner()));
+                    }
+
+                    for (libnest2d::Item& placement : cluster.placements) {
+                        auto translation = placement.translation();
+                        placement.translation(
+                            {libnest2d::getX(translation) - min_x, libnest2d::getY(translation) - min_y});
+                    }
+
+                    cluster.item = rectangle_item(max_x - min_x, max_y - min_y);
+                }
+            };
+
+            std::vector<std::future<void>> futures;
+            futures.reserve(groups.size());
+            for (size_t group = 0; groups.size() > group; group++) {
+                futures.push_back(pool.submit([&build_group, &groups, group]() { build_group(groups[group], group); }));
+            }
+
+            // All groups are waited even after failure, they refer to locals of this function
+            std::exception_ptr error;
+            for (size_t group = 0; groups.size() > group; group++) {
+                try {
+                    pool.wait(futures[group]);
+                } catch (...) {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    continue;
+                }
+
+                progress(std::min(cluster_size, small_items.size() - groups[group]));
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            std::vector<Cluster> clusters;
+            for (auto& group : results) {
+                for (Cluster& cluster : group) {
+                    clusters.push_back(std::move(cluster));
+                }
+            }
+
+            return clusters;
+        }
+
+        // Index of quarter turn closest to rotation
+        size_t quarter_turn(libnest2d::Radians rotation) {
+            long turns = std::lround(rotation.toDegrees() / 90.0) % 4;
+            return (size_t) (turns < 0 ? turns + 4 : turns);
+        }
+
+        // Applies placement of packed cluster to its children
+        void resolve_cluster(const Cluster& cluster,
+                             const libnest2d::Item& placed,
+                             std::vector<libnest2d::Item>& packer_items) {
+            const size_t cluster_turn = quarter_turn(placed.rotation());
+            const auto cluster_translation = placed.translation();
+
+            for (size_t i = 0; cluster.children.size() > i; i++) {
+                const libnest2d::Item& placement = cluster.placements[i];
+                libnest2d::Item& item = packer_items[cluster.children[i]];
+
+                // Child position is rotated by cluster rotation first, the same way packer transforms shapes
+                auto translation = placement.translation();
+                libnest2d::Coord x = libnest2d::getX(translation);
+                libnest2d::Coord y = libnest2d::getY(translation);
+                switch (cluster_turn) {
+                    case 1:
+                        std::tie(x, y) = std::make_pair(-y, x);
+                        break;
+                    case 2:
+                        std::tie(x, y) = std::make_pair(-x, -y);
+                        break;
+                    case 3:
+                        std::tie(x, y) = std::make_pair(y, -x);
+                        break;
+                    default:
+                        break;
+                }
+
+                item = placement;
+                item.rotation(QuarterTurns[(cluster_turn + quarter_turn(placement.rotation())) % 4]);
+                item.translation(
+                    {x + libnest2d::getX(cluster_translation), y + libnest2d::getY(cluster_translation)});
+                item.binId(placed.binId());
+            }
+        }
+    }
+
+    Generator::Generator(const Config& config, Ref<ThreadPool> pool, Ref<PolygonCache> cache) :
+        m_config(config),
+        m_snapshot(m_config.snapshot()),
+        m_pool(pool),
+        m_cache(cache),
+        m_buffers(CreateRef<BufferManager>(m_config.memory_budget(), m_config.scratch_directory())) {
+        if (!m_pool) {
+#if WK_DEBUG
+            size_t threads = 1;
+#else
+            size_t threads = m_config.parallel() ? m_config.threads() : 1;
+#endif
+            m_pool = CreateRef<ThreadPool>(threads, m_config.pin_threads());
+        }
+    }
+
+    float Generator::progress() const {
+        const size_t total = m_total_item_counter;
+        if (!total)
+            return 0.0f;
+
+        const size_t processed = m_item_counter + m_duplicate_item_counter;
+        return std::min((float) processed / total, 1.0f);
+    }
+
+    size_t Generator::peak_memory() const {
+        return m_buffers->peak();
+    }
+
+    void Generator::set_result_cache(Ref<ResultCache> cache, uint64_t salt) {
+        m_result_cache = cache;
+        m_result_salt = salt;
+    }
+
+    void Generator::hash_config(Hasher& hasher) const {
+        hasher.update(ResultCache::Version);
+        hasher.update(m_result_salt);
+
+        hasher.update(m_config.width());
+        hasher.update(m_config.height());
+        hasher.update(m_config.scale());
+        hasher.update(m_config.extrude());
+        hasher.update(m_config.alpha_threshold());
+        hasher.update(m_config.split_islands());
+        hasher.update(m_config.island_distance());
+        hasher.update(m_config.split_oversized());
+        hasher.update(m_config.tile_overlap());
+        hasher.update(m_config.block_size());
+        hasher.update(m_config.minimize_pages());
+        hasher.update(m_config.page_constraint());
+        hasher.update(m_config.packing_accuracy());
+        hasher.update(m_config.packing_selection());
+        hasher.update(m_config.packing_rotations());
+        hasher.update(m_config.vertex_budget());
+        hasher.update(m_config.packing_portfolio());
+        hasher.update(m_config.hierarchical_packing());
+        hasher.update(m_config.cluster_size());
+
+        hasher.update<uint64_t>(m_config.scale_levels().size());
+        for (float level : m_config.scale_levels()) {
+            hasher.update(level);
+        }
+    }
+
+    void Generator::check_cancelled() const {
+        if (m_cancelled) {
+            throw PackagingException(PackagingException::Reason::Cancelled);
+        }
+    }
+
+    void Generator::release_state(bool drop_atlases) {
+        m_buffers->clear();
+        m_items = {};
+        m_duplicate_indices = {};
+        m_part_items = {};
+        m_part_owners = {};
+        m_palettes = {};
+        m_colorfill_items = {};
+
+        if (drop_atlases) {
+            size_t atlas_memory = 0;
+            for (const RawImage& atlas : m_atlases) {
+                atlas_memory += atlas.data_length();
+            }
+            for (const auto& atlases : m_scaled_atlases) {
+                for (const RawImage& atlas : atlases) {
+                    atlas_memory += atlas.data_length();
+                }
+            }
+            m_buffers->release(atlas_memory);
+
+            m_atlases = {};
+            m_scaled_atlases = {};
+        }
     }
 
     RawImage& Generator::get_atlas(size_t atlas) {
         return m_atlases[atlas];
     }
 
+    RawImage& Generator::get_atlas(size_t atlas, size_t level) {
+        return m_scaled_atlases[level][atlas];
+    }
+
+    PointUV Generator::get_scaled_uv(size_t atlas, size_t level, PointUV uv) const {
+        const RawImage& source = m_atlases[atlas];
+        const RawImage& scaled = m_scaled_atlases[level][atlas];
+
+        return PointUV((uint16_t) std::round((float) uv.x * scaled.width() / source.width()),
+                       (uint16_t) std::round((float) uv.y * scaled.height() / source.height()));
+    }
+
+    void Generator::get_compressed_atlas(size_t atlas, BlockFormat format, Container<uint8_t>& output) {
+        const RawImage& image = m_atlases[atlas];
+        if (!can_encode_blocks(image)) {
+            throw PackagingException(PackagingException::Reason::UnsupportedImage);
+        }
+
+        encode_blocks(image, format, output, *m_pool);
+    }
+
+    uint16_t Generator::scale_divisor() const {
+        const auto& levels = m_config.scale_levels();
+        if (levels.empty())
+            return 1;
+
+        return (uint16_t) std::ceil(1.f / levels.back());
+    }
+
+    Image::Size Generator::page_size(int64_t used_width, int64_t used_height) const {
+        const uint16_t block = m_config.block_size();
+        const uint16_t divisor = scale_divisor();
+
+        int64_t width = used_width * block + (block > 1 ? 0 : extrude_size());
+        int64_t height = used_height * block + (block > 1 ? 0 : extrude_size());
+
+        width = ((width + divisor - 1) / divisor) * divisor;
+        height = ((height + divisor - 1) / divisor) * divisor;
+
+        switch (m_config.page_constraint()) {
+            case Config::PageConstraint::MultipleOf4:
+                width = ((width + 3) / 4) * 4;
+                height = ((height + 3) / 4) * 4;
+                break;
+            case Config::PageConstraint::PowerOfTwo: {
+                int64_t pot_width = 1;
+                int64_t pot_height = 1;
+                while (width > pot_width) {
+                    pot_width <<= 1;
+                }
+                while (height > pot_height) {
+                    pot_height <<= 1;
+                }
+
+                width = pot_width;
+                height = pot_height;
+            } break;
+            default:
+                break;
+        }
+
+        return Image::Size((Image::SizeT) std::clamp<int64_t>(width, 1, m_config.width()),
+                           (Image::SizeT) std::clamp<int64_t>(height, 1, m_config.height()));
+    }
+
+    uint16_t Generator::extrude_size() const {
+        return m_config.extrude() * scale_divisor();
+    }
+
+    void Generator::generate_scaled_atlases(size_t atlas_offset) {
+        const auto& levels = m_config.scale_levels();
+        m_scaled_atlases.resize(levels.size());
+
+        for (size_t level = 0; levels.size() > level; level++) {
+            check_cancelled();
+
+            const float scale = levels[level];
+            Container<RawImage>& atlases = m_scaled_atlases[level];
+
+            atlases.reserve(m_atlases.size());
+            for (size_t i = atlas_offset; m_atlases.size() > i; i++) {
+                const RawImage& atlas = m_atlases[i];
+
+                atlases.emplace_back((uint16_t) std::max(std::ceil(atlas.width() * scale), 1.f),
+                                     (uint16_t) std::max(std::ceil(atlas.height() * scale), 1.f),
+                                     atlas.depth(),
+                                     atlas.colorspace());
+                m_buffers->reserve(atlases.back().data_length());
+            }
+
+            m_pool->enumerate(atlases.begin() + atlas_offset, atlases.end(), [&](RawImage& atlas, size_t i) {
+                const RawImage& source = m_atlases[atlas_offset + i];
+                Image::Bound bound = {0, 0, source.width(), source.height()};
+
+                if (can_resample(source)) {
+                    resample(source, bound, atlas);
+                } else {
+                    source.copy(atlas);
+                }
+            });
+        }
+    }
+
     bool Generator::validate_image(const RawImage& image) {
         if (1 > image.width() || 1 > image.height()) {
             return false;
@@ -24,12 +658,309 @@ namespace wk::AtlasGenerator {
         return true;
     }
 
+    void Generator::split_islands(Container<size_t>& item_indices) {
+        Container<Container<Item>> islands(m_items.size());
+
+        m_pool->enumerate(m_items.begin(), m_items.end(), [&](Item& item, size_t i) {
+            if (item.status() == Item::Status::Unset && !m_cancelled) {
+                item.split_islands(m_config, islands[i]);
+            }
+        });
+        check_cancelled();
+
+        replace_by_parts(islands, item_indices);
+    }
+
+    std::set<size_t> Generator::split_tiles(Container<size_t>& item_indices) {
+        // Tile with extrusion on both sides and padding to block grid has to fit into page
+        const int32_t extrude = extrude_size();
+        const int32_t padding = m_config.block_size() - 1;
+        const uint16_t max_width = (uint16_t) std::max<int32_t>(m_config.width() - extrude * 2 - padding, 1);
+        const uint16_t max_height = (uint16_t) std::max<int32_t>(m_config.height() - extrude * 2 - padding, 1);
+
+        Container<Container<Item>> tiles(m_items.size());
+        Container<uint8_t> untiled(m_items.size(), 0);
+
+        m_pool->enumerate(m_items.begin(), m_items.end(), [&](Item& item, size_t i) {
+            if (item.status() == Item::Status::Unset && !m_cancelled) {
+                untiled[i] = !item.split_tiles(m_config, max_width, max_height, tiles[i]);
+            }
+        });
+        check_cancelled();
+
+        // Parts of split item share index of their source item, so it is reported once
+        std::set<size_t> failed_items;
+        for (size_t i = 0; m_items.size() > i; i++) {
+            if (untiled[i] && failed_items.insert(item_indices[i]).second) {
+                record_failure(item_indices[i], PackagingException::Reason::TooBigImage);
+            }
+        }
+
+        replace_by_parts(tiles, item_indices);
+        if (!failed_items.empty()) {
+            drop_failed_items(failed_items, item_indices);
+        }
+
+        return failed_items;
+    }
+
+    void Generator::replace_by_parts(Container<Container<Item>>& parts, Container<size_t>& item_indices) {
+        size_t part_count = 0;
+        for (const Container<Item>& item_parts : parts) {
+            part_count += item_parts.size();
+        }
+
+        if (!part_count)
+            return;
+
+        Container<std::reference_wrapper<Item>> items;
+        Container<size_t> indices;
+        std::map<size_t, size_t> part_owners;
+        items.reserve(m_items.size() + part_count);
+        indices.reserve(m_items.size() + part_count);
+
+        for (size_t i = 0; m_items.size() > i; i++) {
+            Item& item = m_items[i];
+            size_t item_index = item_indices[i];
+
+            if (parts[i].empty()) {
+                // Parts of previous split keep their owners
+                auto owner = m_part_owners.find(i);
+                if (owner != m_part_owners.end()) {
+                    part_owners[items.size()] = owner->second;
+                }
+
+                items.push_back(item);
+                indices.push_back(item_index);
+                continue;
+            }
+
+            item.vertices.clear();
+            item.parts.clear();
+            for (Item& part : parts[i]) {
+                part_owners[items.size()] = item_index;
+
+                // Parts are referenced from m_items, deque keeps them in place when it grows
+                items.push_back(m_part_items.emplace_back(std::move(part)));
+                indices.push_back(item_index);
+            }
+        }
+
+        m_items = std::move(items);
+        m_part_owners = std::move(part_owners);
+        item_indices = std::move(indices);
+    }
+
+    void Generator::record_failure(size_t index, PackagingException::Reason reason) {
+        if (m_config.failure_policy() == Config::FailurePolicy::Throw) {
+            throw PackagingException(reason, index);
+        }
+
+        m_failures.push_back({index, reason});
+    }
+
+    void Generator::drop_failed_items(const std::set<size_t>& failed_items, Container<size_t>& item_indices) {
+        Container<std::reference_wrapper<Item>> items;
+        Container<size_t> indices;
+        std::map<size_t, size_t> part_owners;
+        items.reserve(m_items.size());
+        indices.reserve(m_items.size());
+
+        for (size_t i = 0; m_items.size() > i; i++) {
+            if (failed_items.count(item_indices[i]))
+                continue;
+
+            auto owner = m_part_owners.find(i);
+            if (owner != m_part_owners.end()) {
+                part_owners[items.size()] = owner->second;
+            }
+
+            items.push_back(m_items[i]);
+            indices.push_back(item_indices[i]);
+        }
+
+        m_items = std::move(items);
+        m_part_owners = std::move(part_owners);
+        item_indices = std::move(indices);
+    }
+
+    void Generator::build_palette(Container<size_t>& item_indices) {
+        Container<std::reference_wrapper<Item>> items;
+        Container<size_t> indices;
+        items.reserve(m_items.size());
+        indices.reserve(m_items.size());
+
+        for (size_t i = 0; m_items.size() > i; i++) {
+            Item& item = m_items[i];
+
+            if (item.is_colorfill() && item.status() == Item::Status::Unset) {
+                m_colorfill_items.push_back(item);
+            } else {
+                items.push_back(item);
+                indices.push_back(item_indices[i]);
+            }
+        }
+
+        if (m_colorfill_items.empty())
+            return;
+
+        // Cells are big enough to keep their color after area downsampling of scaled atlases
+        const size_t count = m_colorfill_items.size();
+        const uint16_t cell_size = PaletteCellSize * scale_divisor();
+        const Point grid = palette_grid();
+        const size_t capacity = (size_t) grid.x * grid.y;
+
+        for (size_t offset = 0; count > offset; offset += capacity) {
+            // Square block of cells, made wider when page is not tall enough for it
+            const size_t cell_count = std::min(capacity, count - offset);
+            const size_t square = (size_t) std::ceil(std::sqrt((double) cell_count));
+            const size_t min_columns = (cell_count + grid.y - 1) / grid.y;
+            const uint16_t columns = (uint16_t) std::min<size_t>(std::max(square, min_columns), grid.x);
+            const uint16_t rows = (uint16_t) ((cell_count + columns - 1) / columns);
+
+            const RawImage& first = m_colorfill_items[offset].get().image();
+            RawImageRef palette =
+                CreateRef<RawImage>(columns * cell_size, rows * cell_size, first.depth(), first.colorspace());
+            std::memset(palette->data(), 0, palette->data_length());
+
+            const uint8_t pixel_size = palette->pixel_size();
+            for (size_t i = 0; cell_count > i; i++) {
+                const RawImage& color = m_colorfill_items[offset + i].get().image();
+                const uint16_t x = (uint16_t) (i % columns) * cell_size;
+                const uint16_t y = (uint16_t) (i / columns) * cell_size;
+
+                // Colors are premultiplied the same way as images of other items
+                uint8_t texel[4];
+                Memory::copy(color.at(0, 0), texel, pixel_size);
+                if (pixel_size == 4 || pixel_size == 2) {
+                    const float alpha = (float) texel[pixel_size - 1] / 255.f;
+                    for (uint8_t c = 0; pixel_size - 1 > c; c++) {
+                        texel[c] = (uint8_t) (texel[c] * alpha);
+                    }
+                }
+
+                for (uint16_t h = 0; cell_size > h; h++) {
+                    for (uint16_t w = 0; cell_size > w; w++) {
+                        Memory::copy(texel, palette->at(x + w, y + h), pixel_size);
+                    }
+                }
+            }
+
+            Ref<Item> item = m_palettes.emplace_back(CreateRef<Item>(palette));
+
+            const uint16_t width = palette->width();
+            const uint16_t height = palette->height();
+            item->vertices = {Vertex(width, 0, width, 0),
+                              Vertex(width, height, width, height),
+                              Vertex(0, height, 0, height),
+                              Vertex(0, 0, 0, 0)};
+            item->mark_as_custom();
+
+            items.push_back(*item);
+            indices.push_back(SIZE_MAX);
+        }
+
+        m_item_counter += count - m_palettes.size();
+        m_items = std::move(items);
+        item_indices = std::move(indices);
+    }
+
+    void Generator::assign_palette_cells() {
+        if (m_palettes.empty())
+            return;
+
+        const size_t count = m_colorfill_items.size();
+        const int32_t divisor = scale_divisor();
+        const uint16_t cell_size = PaletteCellSize * divisor;
+        const Point grid = palette_grid();
+        const size_t capacity = (size_t) grid.x * grid.y;
+
+        for (size_t i = 0; count > i; i++) {
+            Item& item = m_colorfill_items[i];
+            const Point size = item.colorfill_size(m_config);
+
+            // Every palette except the last one is full
+            const Item& palette = *m_palettes[i / capacity];
+            const size_t cell = i % capacity;
+            const uint16_t columns = palette.width() / cell_size;
+
+            // Cell bound in atlas, palette may be rotated and placed at any position
+            Point first((int32_t) (cell % columns) * cell_size, (int32_t) (cell / columns) * cell_size);
+            Point last(first.x + cell_size, first.y + cell_size);
+            palette.transform.transform_point(first);
+            palette.transform.transform_point(last);
+
+            // Color is sampled at common corner of 2x2 blocks aligned to divisor grid,
+            // so every scaled atlas has the same color in all texels around uv
+            auto sample_point = [divisor](int32_t a, int32_t b) {
+                const int32_t start = std::min(a, b);
+                return (uint16_t) (((start + divisor - 1) / divisor) * divisor + divisor);
+            };
+            const uint16_t u = sample_point(first.x, last.x);
+            const uint16_t v = sample_point(first.y, last.y);
+
+            // Uv is already in atlas space
+            item.texture_index = palette.texture_index;
+            item.transform = Item::Transformation<int32_t>();
+            item.vertices = {
+                Vertex(size.x, 0, u, v), Vertex(size.x, size.y, u, v), Vertex(0, size.y, u, v), Vertex(0, 0, u, v)};
+        }
+    }
+
+    Point Generator::palette_grid() const {
+        // The same bound as for tiles of oversized items
+        const int32_t extrude = extrude_size();
+        const int32_t padding = m_config.block_size() - 1;
+        const int32_t cell_size = PaletteCellSize * scale_divisor();
+
+        return Point(std::max<int32_t>((m_config.width() - extrude * 2 - padding) / cell_size, 1),
+                     std::max<int32_t>((m_config.height() - extrude * 2 - padding) / cell_size, 1));
+    }
+
+    void Generator::generate_polygon(Item& item, size_t index) {
+        // Parts of split items are placed by their offset in source item, so they are not shared
+        if (!m_cache || m_part_owners.count(index)) {
+            item.generate_image_polygon(m_config);
+            return;
+        }
+
+        const Hash128 key = PolygonCache::key(item, m_config);
+        if (m_cache->load(key, m_config, item))
+            return;
+
+        item.generate_image_polygon(m_config);
+        m_cache->store(key, item);
+    }
+
     bool Generator::pack_items(Image::PixelDepth atlas_type) {
+        // With block alignment items are packed as rectangles on grid of blocks, including their extrusion
+        const uint16_t block = m_config.block_size();
+        const uint16_t extrude = extrude_size();
+
         // Vector with polygons for libnest2d
         std::vector<libnest2d::Item> packer_items;
         packer_items.reserve(m_items.size());
 
         for (const Item& item : m_items) {
+            if (block > 1) {
+                libnest2d::Coord width = (item.width() + extrude * 2 + block - 1) / block;
+                libnest2d::Coord height = (item.height() + extrude * 2 + block - 1) / block;
+
+                packer_items.emplace_back(std::vector<libnest2d::Point>(
+                    {{width, 0}, {width, height}, {0, height}, {0, 0}, {width, 0}}));
+                continue;
+            }
+
+            // Tile polygon does not cover its overlap, so whole tile image is packed
+            if (item.is_tile()) {
+                libnest2d::Coord width = item.width();
+                libnest2d::Coord height = item.height();
+
+                packer_items.emplace_back(std::vector<libnest2d::Point>(
+                    {{width, 0}, {width, height}, {0, height}, {0, 0}, {width, 0}}));
+                continue;
+            }
+
             libnest2d::Item& packer_item =
                 packer_items.emplace_back(std::vector<libnest2d::Point>(item.vertices.size() + 1));
 
@@ -42,39 +973,214 @@ namespace wk::AtlasGenerator {
             }
         }
 
-        libnest2d::NestConfig<libnest2d::NfpPlacer, libnest2d::FirstFitSelection> cfg;
-        cfg.placer_config.alignment = libnest2d::NestConfig<>::Placement::Alignment::DONT_ALIGN;
-        cfg.placer_config.starting_point = libnest2d::NestConfig<>::Placement::Alignment::BOTTOM_LEFT;
-        cfg.placer_config.parallel = m_config.parallel();
-#if WK_DEBUG
-        cfg.placer_config.accuracy = 1.0f;
-#else
-        cfg.placer_config.accuracy = 0.6f;
-#endif
-        cfg.selector_config.verify_items = false;
-        // cfg.selector_config.texture_parallel_hard = m_config.parallel();
+        const bool portfolio = m_config.packing_portfolio();
 
         libnest2d::NestControl control;
-        if (m_config.progress) {
-            control.progressfn = [&](unsigned) { m_config.progress(m_duplicate_item_counter + m_item_counter++); };
+        control.progressfn = [&](unsigned) {
+            size_t processed = m_duplicate_item_counter + m_item_counter++;
+            if (m_config.progress) {
+                m_config.progress(processed);
+            }
+        };
+        control.stopcond = [this]() { return m_cancelled.load(); };
+
+        // Progress of several items at once, called from this thread only
+        auto report_progress = [&](size_t count) {
+            m_item_counter += count;
+            if (m_config.progress) {
+                m_config.progress(m_duplicate_item_counter + m_item_counter);
+            }
+        };
+
+        // Progress is reported by default strategy only
+        libnest2d::NestControl portfolio_control;
+        portfolio_control.stopcond = control.stopcond;
+
+        auto page_area = [this](libnest2d::Coord width, libnest2d::Coord height) {
+            Image::Size size = page_size(width, height);
+            return (size_t) size.x * size.y;
+        };
+
+        const uint16_t bin_width = m_config.width() / block;
+        const uint16_t bin_height = m_config.height() / block;
+        const libnest2d::Box bin(bin_width, bin_height, {(int) ceil(bin_width / 2), (int) ceil(bin_height / 2)});
+        const libnest2d::Coord distance = block > 1 ? 0 : extrude * 2;
+
+        const PackingStrategy configured = {m_config.packing_selection() == Config::PackingSelection::DJD,
+                                            ItemOrder::Area,
+                                            m_config.packing_accuracy(),
+                                            Alignment::BOTTOM_LEFT};
+        const Config::PackingRotations rotations = m_config.packing_rotations();
+
+        // In hierarchical mode small items are packed into rigid clusters first,
+        // so top level packer works with much fewer items
+        std::vector<Cluster> clusters;
+        std::vector<bool> clustered;
+        std::vector<libnest2d::Item> nest_items;
+        if (m_config.hierarchical_packing()) {
+            std::vector<size_t> small_items;
+            for (size_t i = 0; packer_items.size() > i; i++) {
+                auto box = packer_items[i].boundingBox();
+                if (bin_width / ClusterItemDivisor >= box.width() && bin_height / ClusterItemDivisor >= box.height()) {
+                    small_items.push_back(i);
+                } else {
+                    nest_items.push_back(packer_items[i]);
+                }
+            }
+
+            if (small_items.size() > m_config.cluster_size()) {
+                clusters = build_clusters(packer_items,
+                                          small_items,
+                                          m_config.cluster_size(),
+                                          bin_width,
+                                          bin_height,
+                                          distance,
+                                          make_nest_config<libnest2d::FirstFitSelection>(configured, rotations),
+                                          control,
+                                          report_progress,
+                                          *m_pool);
+                check_cancelled();
+
+                clustered.resize(packer_items.size(), false);
+                for (size_t index : small_items) {
+                    clustered[index] = true;
+                }
+
+                for (const Cluster& cluster : clusters) {
+                    nest_items.push_back(cluster.item);
+                }
+            } else {
+                nest_items = packer_items;
+            }
+        } else {
+            nest_items = packer_items;
+        }
+
+        // Items inside of clusters already reported their progress, top level packing reports the rest at once
+        const bool report_top_level = clusters.empty();
+
+        // Configured strategy goes first, portfolio adds only strategies that differ from it
+        std::vector<PackingStrategy> strategies = {configured};
+        if (portfolio) {
+            for (const PackingStrategy& strategy : PortfolioStrategies) {
+                if (!(strategy == configured)) {
+                    strategies.push_back(strategy);
+                }
+            }
+        }
+
+        std::vector<PackingResult> results(strategies.size());
+        m_pool->enumerate(results.begin(), results.end(), [&](PackingResult& result, size_t i) {
+            const PackingStrategy& strategy = strategies[i];
+            const libnest2d::NestControl& strategy_control =
+                i == 0 && report_top_level ? control : portfolio_control;
+
+            result.items = nest_items;
+            apply_item_order(result.items, strategy.order);
+
+            if (strategy.djd_selection) {
+                result.bin_count = libnest2d::nest(result.items,
+                                                   bin,
+                                                   distance,
+                                                   make_nest_config<libnest2d::DJDHeuristic>(strategy, rotations),
+                                                   strategy_control);
+            } else {
+                result.bin_count =
+                    libnest2d::nest(result.items,
+                                    bin,
+                                    distance,
+                                    make_nest_config<libnest2d::FirstFitSelection>(strategy, rotations),
+                                    strategy_control);
+            }
+
+            result.complete = std::all_of(result.items.begin(), result.items.end(), [](const libnest2d::Item& item) {
+                return item.binId() != libnest2d::BIN_ID_UNSET;
+            });
+            if (!result.complete)
+                return;
+
+            if (strategy.starting_point != Alignment::BOTTOM_LEFT) {
+                normalize_bins(result.items, result.bin_count);
+            }
+
+            std::vector<std::pair<libnest2d::Coord, libnest2d::Coord>> used(result.bin_count);
+            for (const libnest2d::Item& item : result.items) {
+                auto box = item.boundingBox();
+                auto& size = used[item.binId()];
+
+                size.first = std::max(size.first, libnest2d::getX(box.maxCorner()));
+                size.second = std::max(size.second, libnest2d::getY(box.maxCorner()));
+            }
+
+            for (const auto& [width, height] : used) {
+                result.area += page_area(width, height);
+            }
+        });
+        check_cancelled();
+
+        // Fewest pages first, then the smallest total area. Ties are resolved by strategy order to stay deterministic
+        size_t best = 0;
+        for (size_t i = 1; results.size() > i; i++) {
+            const PackingResult& candidate = results[i];
+            const PackingResult& current = results[best];
+
+            if (candidate.complete != current.complete) {
+                if (candidate.complete)
+                    best = i;
+                continue;
+            }
+
+            if (candidate.bin_count != current.bin_count) {
+                if (current.bin_count > candidate.bin_count)
+                    best = i;
+                continue;
+            }
+
+            if (current.area > candidate.area)
+                best = i;
         }
 
+        nest_items = std::move(results[best].items);
+        size_t bin_count = results[best].bin_count;
         size_t bin_offset = m_atlases.size();
-        size_t bin_count = nest(packer_items,
-                                libnest2d::Box(m_config.width(),
-                                               m_config.height(),
-                                               {(int) ceil(m_config.width() / 2), (int) ceil(m_config.height() / 2)}),
-                                m_config.extrude() * 2,
-                                cfg,
-                                control);
 
-        // Gathering texture size info
-        std::vector<Image::Size> sheet_size(bin_count);
-        for (libnest2d::Item item : packer_items) {
+        for (const libnest2d::Item& item : nest_items) {
             if (item.binId() == libnest2d::BIN_ID_UNSET) {
                 return false;
             };
+        }
+
+        if (m_config.minimize_pages() && bin_count) {
+            minimize_bin(nest_items,
+                         (int) bin_count - 1,
+                         distance,
+                         make_nest_config<libnest2d::FirstFitSelection>(configured, rotations),
+                         page_area,
+                         control,
+                         *m_pool);
+            check_cancelled();
+        }
 
+        if (clusters.empty()) {
+            packer_items = std::move(nest_items);
+        } else {
+            // Non clustered items go first in the same order as they were collected
+            size_t top_index = 0;
+            for (size_t i = 0; packer_items.size() > i; i++) {
+                if (!clustered[i]) {
+                    packer_items[i] = nest_items[top_index++];
+                    control.progressfn(0);
+                }
+            }
+
+            for (size_t i = 0; clusters.size() > i; i++) {
+                resolve_cluster(clusters[i], nest_items[top_index + i], packer_items);
+            }
+        }
+
+        // Gathering texture size info
+        std::vector<Image::Size> sheet_size(bin_count);
+        for (libnest2d::Item item : packer_items) {
             auto box = item.boundingBox();
             auto& size = sheet_size[item.binId()];
 
@@ -91,15 +1197,16 @@ namespace wk::AtlasGenerator {
 
         m_atlases.reserve(sheet_size.size());
         for (const auto& size : sheet_size) {
-            uint16_t width = (uint16_t) (size.x + m_config.extrude());
-            uint16_t height = (uint16_t) (size.y + m_config.extrude());
+            Image::Size atlas_size = page_size(size.x, size.y);
 
-            m_atlases.emplace_back(std::clamp<uint16_t>(width, 0, m_config.width()),
-                                   std::clamp<uint16_t>(height, 0, m_config.height()),
-                                   atlas_type);
+            m_atlases.emplace_back(atlas_size.x, atlas_size.y, atlas_type);
+            m_buffers->reserve(m_atlases.back().data_length());
         }
+        m_report.pages.resize(m_atlases.size() - m_result_offset);
 
         for (size_t i = 0; m_items.size() > i; i++) {
+            check_cancelled();
+
             libnest2d::Item packer_item = packer_items[i];
             Item& item = m_items[i];
 
@@ -114,145 +1221,167 @@ namespace wk::AtlasGenerator {
             item.transform.translation.x = (int32_t) libnest2d::getX(packer_item.translation());
             item.transform.translation.y = (int32_t) libnest2d::getY(packer_item.translation());
 
+            const RawImage& image = m_buffers->acquire(item);
+            report_item(item, image);
+
             auto index = item.texture_index;
             auto x = (uint16_t) (libnest2d::getX(box.minCorner()));
             auto y = (uint16_t) (libnest2d::getY(box.minCorner()));
 
-            place_image_to(item.image_ref(), index, x, y, (Item::FixedRotation) rotation_degree);
-        }
-
-        return true;
-    }
+            if (block > 1) {
+                const uint16_t cell_x = x * block;
+                const uint16_t cell_y = y * block;
+                x = cell_x + extrude;
+                y = cell_y + extrude;
 
-    void Generator::place_image_to(
-        RawImageRef input, size_t atlas_index, uint16_t x, uint16_t y, Item::FixedRotation rotation) {
-        const uint8_t extrude = m_config.extrude();
-        uint16_t extuded_width = input->width() + (extrude * 2);
-        uint16_t extuded_height = input->height() + (extrude * 2);
-        RawImageRef image = CreateRef<RawImage>(extuded_width, extuded_height, input->depth(), input->colorspace());
-        x -= extrude;
-        y -= extrude;
-
-        for (uint16_t h = 0; input->height() > h; h++) {
-            for (uint16_t w = 0; input->width() > w; w++) {
-                Memory::copy(input->at(w, h), image->at(w + extrude, h + extrude), input->pixel_size());
-            }
-        }
+                // Packer works with block units, so translation is calculated from rotated polygon bound.
+                // Tile image is bigger than its polygon, so bound of whole image is used for it
+                Item::Transformation<int32_t> rotation_transform(rotation);
+                int32_t min_x = std::numeric_limits<int32_t>::max();
+                int32_t min_y = std::numeric_limits<int32_t>::max();
+                auto update_bound = [&](int32_t u, int32_t v) {
+                    Point point(u, v);
+                    rotation_transform.transform_point(point);
 
-        {
-            const uint16_t dstX = extrude;
-            const uint16_t dstY = image->width() - extrude - 1;
-            // left
-            for (uint16_t h = 0; image->height() > h; h++) {
-                uint8_t* pixel = image->at(dstX, h);
+                    min_x = std::min(min_x, point.x);
+                    min_y = std::min(min_y, point.y);
+                };
 
-                for (uint16_t i = 0; extrude > i; i++) {
-                    Memory::copy(pixel, image->at(i, h), image->pixel_size());
+                if (item.is_tile()) {
+                    update_bound(0, 0);
+                    update_bound(item.width(), 0);
+                    update_bound(item.width(), item.height());
+                    update_bound(0, item.height());
+                } else {
+                    for (const Vertex& vertex : item.vertices) {
+                        update_bound(vertex.uv.x, vertex.uv.y);
+                    }
                 }
-            }
 
-            // right
-            for (uint16_t h = 0; image->height() > h; h++) {
-                uint8_t* pixel = image->at(dstY, h);
+                item.transform.translation.x = x - min_x;
+                item.transform.translation.y = y - min_y;
 
-                for (uint16_t i = 0; extrude > i; i++) {
-                    Memory::copy(pixel, image->at(i + dstY + 1, h), image->pixel_size());
-                }
+                bool swap_sides = rotation_degree == Item::Rotation90 || rotation_degree == Item::Rotation270;
+                uint16_t width = (swap_sides ? item.height() : item.width()) + extrude * 2;
+                uint16_t height = (swap_sides ? item.width() : item.height()) + extrude * 2;
+
+                place_image_to(image, index, x, y, (Item::FixedRotation) rotation_degree);
+                fill_block_padding(index,
+                                   cell_x,
+                                   cell_y,
+                                   width,
+                                   height,
+                                   (uint16_t) (libnest2d::getX(box.maxCorner()) * block) - cell_x,
+                                   (uint16_t) (libnest2d::getY(box.maxCorner()) * block) - cell_y);
+                continue;
             }
+
+            place_image_to(image, index, x, y, (Item::FixedRotation) rotation_degree);
         }
 
-        {
-            const uint16_t dstX = extrude;
-            const uint16_t dstY = image->height() - extrude - 1;
-            // bottom
-            for (uint16_t w = 0; image->width() > w; w++) {
-                uint8_t* pixel = image->at(w, dstX);
+        report_pages(bin_offset);
+        return true;
+    }
 
-                for (uint16_t i = 0; extrude > i; i++) {
-                    Memory::copy(pixel, image->at(w, i), image->pixel_size());
-                }
-            }
+    void Generator::report_item(const Item& item, const RawImage& image) {
+        PageReport& page = m_report.pages[item.texture_index - m_result_offset];
+        page.item_count++;
 
-            // top
-            for (uint16_t w = 0; image->width() > w; w++) {
-                uint8_t* pixel = image->at(w, dstY);
+        // Shoelace formula, vertices are in source image texels
+        double area = 0.0;
+        double perimeter = 0.0;
+        for (size_t i = 0; item.vertices.size() > i; i++) {
+            const PointUV& current = item.vertices[i].uv;
+            const PointUV& next = item.vertices[(i + 1) % item.vertices.size()].uv;
 
-                for (uint16_t i = 0; extrude > i; i++) {
-                    Memory::copy(pixel, image->at(w, i + dstY + 1), image->pixel_size());
-                }
-            }
+            area += (double) current.x * next.y - (double) next.x * current.y;
+            perimeter += std::hypot((double) next.x - current.x, (double) next.y - current.y);
         }
 
-        uint16_t width = image->width() - 1;
-        uint16_t height = image->height() - 1;
+        // Extrusion band is approximated by polygon perimeter and its corner squares
+        const double extrude = extrude_size();
+        page.polygon_area += std::abs(area) / 2.0;
+        page.extrusion_area += perimeter * extrude + 4.0 * extrude * extrude;
 
-        auto rotate_pixel = [rotation, width, height](uint16_t x, uint16_t y) -> std::pair<uint16_t, uint16_t> {
-            int16_t rotatedX = width - x;
-            int16_t rotatedY = height - y;
+        if (item.has_rectangle_polygon()) {
+            m_report.rectangle_count++;
+        }
 
-            switch (rotation) {
-                case wk::AtlasGenerator::Item::Rotation90:
-                    return {rotatedY, x};
-                case wk::AtlasGenerator::Item::Rotation180:
-                    return {rotatedX, rotatedY};
-                case wk::AtlasGenerator::Item::Rotation270:
-                    return {y, rotatedX};
-                default:
-                    return {x, y};
-            }
-        };
+        Kernels::dispatch(image.depth(), [&](auto format) {
+            using Format = decltype(format);
+            m_report.unique_opaque_pixels += Kernels::count_opaque<Format>(image, m_snapshot.alpha_threshold);
+        });
+    }
 
-        switch (rotation) {
-            case wk::AtlasGenerator::Item::Rotation90:
-            case wk::AtlasGenerator::Item::Rotation270:
-                width = image->height() - 1;
-                height = image->width() - 1;
-                break;
-            default:
-                break;
-        }
+    void Generator::report_pages(size_t atlas_offset) {
+        for (size_t i = atlas_offset; m_atlases.size() > i; i++) {
+            const RawImage& atlas = m_atlases[i];
+            PageReport& page = m_report.pages[i - m_result_offset];
 
-        auto& atlas = m_atlases[atlas_index];
+            page.width = atlas.width();
+            page.height = atlas.height();
 
-        for (uint16_t h = 0; image->height() > h; h++) {
-            for (uint16_t w = 0; image->width() > w; w++) {
-                uint16_t srcW = w;
-                uint16_t srcH = h;
+            Kernels::dispatch(atlas.depth(), [&](auto format) {
+                using Format = decltype(format);
 
-                if (rotation != Item::NoRotation) {
-                    auto [rotatedX, rotatedY] = rotate_pixel(w, h);
-                    srcW = rotatedX;
-                    srcH = rotatedY;
+                // Without alpha every texel is opaque, so polygons are the only source of coverage
+                if constexpr (Format::HasAlpha) {
+                    page.opaque_pixels = Kernels::count_opaque<Format>(atlas, m_snapshot.alpha_threshold);
+                } else {
+                    page.opaque_pixels = (size_t) std::min<double>(page.polygon_area, (double) page.area());
                 }
+            });
 
-                uint16_t dstW = srcW + x;
-                uint16_t dstH = srcH + y;
+            const double covered = std::max((double) page.opaque_pixels, page.polygon_area + page.extrusion_area);
+            page.wasted_area = std::max((double) page.area() - covered, 0.0);
 
-                if (0 > dstW || dstW >= atlas.width())
-                    continue;
-                if (0 > dstH || dstH >= atlas.height())
-                    continue;
+            m_report.atlas_bytes += atlas.data_length();
+        }
+    }
 
-                uint8_t* pixel = image->at(w, h);
-                uint8_t alpha = 255;
+    void Generator::fill_block_padding(size_t atlas_index,
+                                       uint16_t x,
+                                       uint16_t y,
+                                       uint16_t width,
+                                       uint16_t height,
+                                       uint16_t cell_width,
+                                       uint16_t cell_height) {
+        auto& atlas = m_atlases[atlas_index];
+        const uint8_t pixel_size = atlas.pixel_size();
 
-                switch (image->base_type()) {
-                    case Image::BasePixelType::RGBA:
-                        alpha = (*(ColorRGBA*) pixel).a;
-                        break;
-                    case Image::BasePixelType::LA:
-                        alpha = (*(ColorLA*) pixel).a;
-                        break;
-                    default:
-                        break;
-                }
+        const uint16_t right = std::min<uint16_t>(x + cell_width, atlas.width());
+        const uint16_t bottom = std::min<uint16_t>(y + cell_height, atlas.height());
+        if (width == 0 || height == 0 || x + width > right || y + height > bottom)
+            return;
 
-                if (m_config.alpha_threshold() > alpha) {
-                    continue;
-                }
+        // right
+        for (uint16_t h = y; y + height > h; h++) {
+            const uint8_t* pixel = atlas.at(x + width - 1, h);
 
-                Memory::copy(pixel, atlas.at(dstW, dstH), input->pixel_size());
+            for (uint16_t w = x + width; right > w; w++) {
+                Memory::copy(pixel, atlas.at(w, h), pixel_size);
             }
         }
-    };
+
+        // bottom
+        for (uint16_t h = y + height; bottom > h; h++) {
+            Memory::copy(atlas.at(x, y + height - 1), atlas.at(x, h), (size_t) (right - x) * pixel_size);
+        }
+    }
+
+    void Generator::place_image_to(
+        const RawImage& input, size_t atlas_index, uint16_t x, uint16_t y, Item::FixedRotation rotation) {
+        const uint16_t extrude = m_snapshot.extrude * scale_divisor();
+        auto& atlas = m_atlases[atlas_index];
+
+        bool supported = Kernels::dispatch(input.depth(), [&](auto format) {
+            using Format = decltype(format);
+            Kernels::blit_extruded<Format>(
+                input, atlas, (int32_t) x - extrude, (int32_t) y - extrude, rotation, m_snapshot, extrude);
+        });
+
+        if (!supported) {
+            throw PackagingException(PackagingException::Reason::UnsupportedImage);
+        }
+    }
 }
@@ -1,52 +1,286 @@
 #pragma once
 
+#include "Cache/Hash.h"
+#include "Cache/ResultCache.h"
+#include "Compression/BlockEncoder.h"
 #include "Config.h"
+#include "IO/BufferManager.h"
 #include "Item/Item.h"
 #include "Item/Iterator.h"
+#include "Item/PolygonCache.h"
 #include "PackagingException.h"
-#include "core/algorithm/find.hpp"
-#include "core/parallel/enumerate.h"
+#include "Report.h"
+#include "Threading/ThreadPool.h"
+#include "core/memory/ref.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <future>
 #include <map>
 #include <numeric>
+#include <set>
 #include <stdint.h>
 #include <vector>
 
 namespace wk::AtlasGenerator {
+    class Batch;
+
     class Generator {
+        // Batch resets cancellation once before its jobs are started, so late cancel requests are not lost
+        friend class Batch;
+
     public:
-        Generator(const Config& config);
+        /// @param config Generator config
+        /// @param pool Thread pool for all parallel stages. If not provided, generator creates its own pool
+        /// @param cache Storage of processed items that can be shared with other generators
+        Generator(const Config& config, Ref<ThreadPool> pool = nullptr, Ref<PolygonCache> cache = nullptr);
         ~Generator() = default;
 
     public:
         template <typename T = Item>
         size_t generate(Container<T>& items) {
+            m_cancelled = false;
+            return generate_items<T>(items);
+        }
+
+        /// @brief Runs generation in separate thread. Items must stay alive until result is ready
+        /// @return Count of generated atlases. Throws PackagingException with Cancelled reason if run was cancelled
+        template <typename T = Item>
+        std::future<size_t> generate_async(Container<T>& items) {
+            m_cancelled = false;
+            return std::async(std::launch::async, [this, &items]() { return generate_items<T>(items); });
+        }
+
+        /// @brief Requests stop of current generation. Can be called from any thread
+        void cancel() { m_cancelled = true; };
+
+        bool is_cancelled() const { return m_cancelled.load(); };
+
+        /// @brief Returns part of items that are already processed by current generation, from 0 to 1
+        float progress() const;
+
+        /// @brief Packing efficiency of the last generate call
+        const PackingReport& report() const { return m_report; };
+
+        /// @brief Items that were skipped or packed as rectangles by the last generate call.
+        /// Always empty with Throw failure policy
+        const Container<ItemFailure>& failures() const { return m_failures; };
+
+        /// @brief Peak of memory taken by item pixels and atlases that generator tracks, in bytes
+        size_t peak_memory() const;
+
+        /// @brief Enables reuse of whole results of previous runs with the same items and config.
+        /// @param cache Result storage
+        /// @param salt Hash of extra data that affects result and is not stored in items, e.g. slicing guides
+        void set_result_cache(Ref<ResultCache> cache, uint64_t salt = 0);
+
+        RawImage& get_atlas(size_t atlas);
+
+        /// @brief Returns downsampled atlas from additional atlas set
+        /// @param atlas Atlas index
+        /// @param level Index of scale in Config::scale_levels
+        RawImage& get_atlas(size_t atlas, size_t level);
+
+        /// @brief Converts transformed uv coord of main atlas to uv coord of downsampled atlas
+        PointUV get_scaled_uv(size_t atlas, size_t level, PointUV uv) const;
+
+        /// @brief Compresses atlas to GPU block format
+        /// @param atlas Atlas index
+        /// @param format Block format
+        /// @param output Encoded blocks
+        void get_compressed_atlas(size_t atlas, BlockFormat format, Container<uint8_t>& output);
+
+    private:
+        using Iterator = ItemIterator<size_t>::iterator;
+
+        template <typename T = Item>
+        size_t generate_items(Container<T>& items) {
             if (items.empty())
                 return 0;
 
             m_item_counter = 0;
             m_duplicate_item_counter = 0;
+            m_total_item_counter = items.size();
+
+            m_report = {};
+            m_report.item_count = items.size();
+            m_failures.clear();
+
+            m_pool->enumerate(items.begin(), items.end(), [this](Item& item, size_t) {
+                item.detect_uniform(m_config);
+
+                // Pixels are still in cache after detection, hash is used by deduplication and caches
+                if (item.status() != Item::Status::Empty) {
+                    item.hash(*m_pool);
+                }
+            });
 
+            m_result_offset = m_atlases.size();
+
+            Hash128 key;
+            if (m_result_cache) {
+                key = result_key(items);
+                if (load_result(key, items)) {
+                    m_item_counter = items.size();
+
+                    m_report.cached = true;
+                    m_report.pages.resize(m_atlases.size() - m_result_offset);
+                    report_pages(m_result_offset);
+                    return m_atlases.size() - m_result_offset;
+                }
+            }
+
+            try {
+                size_t atlas_count = generate_variants<T>(items);
+
+                // Cache does not keep failures, so partial results are always generated again
+                if (m_result_cache && m_failures.empty()) {
+                    store_result(key, items);
+                }
+
+                return atlas_count;
+            } catch (const PackagingException& exception) {
+                release_state(exception.reason() == PackagingException::Reason::Cancelled);
+                throw;
+            }
+        }
+
+        template <typename T = Item>
+        Hash128 result_key(const Container<T>& items) const {
+            Hasher hasher;
+            hash_config(hasher);
+
+            hasher.update<uint64_t>(items.size());
+            for (const Item& item : items) {
+                const RawImage& image = item.image();
+
+                hasher.update(image.width());
+                hasher.update(image.height());
+                hasher.update(image.depth());
+                hasher.update(item.is_sliced());
+                hasher.update(item.is_colorfill());
+                hasher.update(item.hash());
+
+                // Detected single color items keep 1x1 image, so quad size is hashed separately
+                if (item.is_colorfill()) {
+                    const Point size = item.colorfill_size(m_config);
+                    hasher.update(size.x);
+                    hasher.update(size.y);
+                }
+
+                // Custom polygons
+                hasher.update(item.status());
+                if (item.status() != Item::Status::Unset) {
+                    hasher.update<uint64_t>(item.vertices.size());
+                    for (const Vertex& vertex : item.vertices) {
+                        hasher.update(vertex.uv.x);
+                        hasher.update(vertex.uv.y);
+                        hasher.update(vertex.xy.x);
+                        hasher.update(vertex.xy.y);
+                    }
+                }
+            }
+
+            return hasher.digest();
+        }
+
+        template <typename T = Item>
+        bool load_result(const Hash128& key, Container<T>& items) {
+            ResultCache::Entry entry;
+            if (!m_result_cache->load(key, items.size(), m_config.scale_levels().size(), entry))
+                return false;
+
+            const size_t offset = m_result_offset;
+
+            for (RawImage& atlas : entry.atlases) {
+                m_atlases.push_back(std::move(atlas));
+            }
+
+            m_scaled_atlases.resize(entry.scaled_atlases.size());
+            for (size_t level = 0; entry.scaled_atlases.size() > level; level++) {
+                for (RawImage& atlas : entry.scaled_atlases[level]) {
+                    m_scaled_atlases[level].push_back(std::move(atlas));
+                }
+            }
+
+            for (size_t i = 0; items.size() > i; i++) {
+                Item& item = items[i];
+                ResultCache::Layout& layout = entry.items[i];
+
+                item.texture_index = layout.texture_index == 0xFF ? 0xFF : layout.texture_index + offset;
+                item.vertices = std::move(layout.vertices);
+                item.transform = layout.transform;
+                item.parts = std::move(layout.parts);
+
+                for (Item::Part& part : item.parts) {
+                    part.texture_index += offset;
+                }
+            }
+
+            return true;
+        }
+
+        template <typename T = Item>
+        void store_result(const Hash128& key, const Container<T>& items) {
+            const size_t offset = m_result_offset;
+
+            ResultCache::Entry entry;
+            entry.atlases.assign(m_atlases.begin() + offset, m_atlases.end());
+
+            entry.scaled_atlases.resize(m_scaled_atlases.size());
+            for (size_t level = 0; m_scaled_atlases.size() > level; level++) {
+                const Container<RawImage>& atlases = m_scaled_atlases[level];
+                entry.scaled_atlases[level].assign(atlases.begin() + offset, atlases.end());
+            }
+
+            entry.items.reserve(items.size());
+            for (const Item& item : items) {
+                ResultCache::Layout& layout = entry.items.emplace_back();
+                layout.texture_index = item.texture_index == 0xFF ? 0xFF : item.texture_index - offset;
+                layout.vertices = item.vertices;
+                layout.transform = item.transform;
+                layout.parts = item.parts;
+
+                for (Item::Part& part : layout.parts) {
+                    part.texture_index -= offset;
+                }
+            }
+
+            m_result_cache->store(key, entry);
+        }
+
+        // Adds all config fields that affect result
+        void hash_config(Hasher& hasher) const;
+
+        template <typename T = Item>
+        size_t generate_variants(Container<T>& items) {
             std::map<Image::PixelDepth, size_t> texture_variants;
             for (size_t i = 0; items.size() > i; i++) {
                 Item& item = items[i];
+                if (item.status() == Item::Status::Empty)
+                    continue;
 
                 if (!Generator::validate_image(item.image())) {
-                    throw PackagingException(PackagingException::Reason::UnsupportedImage, i);
+                    record_failure(i, PackagingException::Reason::UnsupportedImage);
+                    item.mark_as_skipped();
+                    continue;
                 }
 
-                if (item.width() > m_config.width() || item.height() > m_config.height()) {
-                    throw PackagingException(PackagingException::Reason::TooBigImage, i);
+                const bool oversized = item.width() > m_config.width() || item.height() > m_config.height();
+                if (oversized && !m_config.split_oversized()) {
+                    record_failure(i, PackagingException::Reason::TooBigImage);
+                    item.mark_as_skipped();
+                    continue;
                 }
 
                 texture_variants[item.image().depth()]++;
             }
 
             if (texture_variants.size() == 1) {
-                const Item& first_item = items[0];
-                auto type = first_item.image().depth();
+                // Empty items are skipped, so they are not taken into account
+                auto type = texture_variants.begin()->first;
 
                 // iterate just by items vector
                 auto it = ItemIterator<size_t>(0, items.size());
@@ -77,31 +311,39 @@ namespace wk::AtlasGenerator {
             return bin_count;
         }
 
-        RawImage& get_atlas(size_t atlas);
-
-    private:
-        using Iterator = ItemIterator<size_t>::iterator;
-
         template <typename T = Item>
         size_t generate(Container<T>& items, ItemIterator<size_t>& item_iterator, Image::PixelDepth depth) {
             Container<size_t> inverse_duplicate_indices;
             inverse_duplicate_indices.reserve(items.size());
 
             for (auto it = item_iterator.begin(); it != item_iterator.end(); ++it) {
+                check_cancelled();
+
                 const size_t i = *it;
                 Item& item = items[i];
 
+                if (item.status() == Item::Status::Skipped) {
+                    m_item_counter++;
+                    continue;
+                }
+
+                if (item.status() == Item::Status::Empty) {
+                    m_report.empty_count++;
+                    m_item_counter++;
+                    continue;
+                }
+
                 // Searching for duplicates
                 {
                     size_t item_index = SIZE_MAX;
 
-                    auto item_it = wk::find_if_parallel(m_items.begin(), m_items.end(), [&item](const Item& other) {
+                    auto item_it = m_pool->find_if(m_items.begin(), m_items.end(), [&item](const Item& other) {
                         return item == other;
                     });
 
                     if (item_it != m_items.end()) {
                         item_index = std::distance(m_items.begin(), item_it);
-                        m_duplicate_indices[i] = item_index;
+                        m_duplicate_indices[i] = inverse_duplicate_indices[item_index];
                         m_duplicate_item_counter++;
                     }
 
@@ -111,69 +353,241 @@ namespace wk::AtlasGenerator {
                 inverse_duplicate_indices.push_back(i);
                 m_items.push_back(item);
             }
+            m_report.unique_item_count += inverse_duplicate_indices.size();
 
-            std::launch policy = std::launch::deferred;
-#if !WK_DEBUG
-            policy |= std::launch::async;
-#endif // !WK_DEBUG
+            build_palette(inverse_duplicate_indices);
+
+            // Islands go first, tiling preprocesses images that are too big and islands need unprocessed ones
+            if (m_config.split_islands()) {
+                split_islands(inverse_duplicate_indices);
+            }
 
-            parallel::enumerate(
-                m_items.begin(),
-                m_items.end(),
-                [&](Item& item, size_t) {
-                    if (item.status() == Item::Status::Unset) {
-                        item.generate_image_polygon(m_config);
+            if (m_config.split_oversized()) {
+                for (size_t index : split_tiles(inverse_duplicate_indices)) {
+                    items[index].mark_as_skipped();
+                }
+            }
+
+            m_pool->enumerate(m_items.begin(), m_items.end(), [&](Item& item, size_t i) {
+                if (item.status() == Item::Status::Unset && !m_cancelled) {
+                    try {
+                        generate_polygon(item, i);
+                    } catch (const std::exception&) {
+                        if (m_config.failure_policy() == Config::FailurePolicy::Throw)
+                            throw;
+
+                        // Reported below together with other invalid polygons
+                        item.vertices.clear();
                     }
-                },
-                policy);
+                }
 
+                // Only preprocessed pixels are needed from now, so they can be evicted
+                m_buffers->track(item);
+            });
+            check_cancelled();
+
+            std::set<size_t> failed_items;
             for (size_t i = 0; m_items.size() > i; i++) {
                 Item& item = m_items[i];
+                if (!item.vertices.empty())
+                    continue;
+
+                // Parts of split item share index of their source item, so it is reported once
+                const size_t index = inverse_duplicate_indices[i];
+                if (failed_items.insert(index).second) {
+                    record_failure(index, PackagingException::Reason::InvalidPolygon);
+                }
 
-                if (item.vertices.empty()) {
-                    throw PackagingException(PackagingException::Reason::InvalidPolygon, inverse_duplicate_indices[i]);
+                if (m_config.failure_policy() == Config::FailurePolicy::Rectangle) {
+                    item.generate_rectangle(m_config);
+                }
+            }
+
+            if (!failed_items.empty() && m_config.failure_policy() == Config::FailurePolicy::Skip) {
+                drop_failed_items(failed_items, inverse_duplicate_indices);
+                for (size_t index : failed_items) {
+                    items[index].mark_as_skipped();
                 }
             }
 
             size_t current_atlas_count = m_atlases.size();
-            if (!pack_items(depth)) {
+            if (!m_items.empty() && !pack_items(depth)) {
                 throw PackagingException(PackagingException::Reason::Unknown);
             };
 
+            if (!m_config.scale_levels().empty()) {
+                generate_scaled_atlases(current_atlas_count);
+            }
+
+            assign_palette_cells();
+
+            m_report.colorfill_count += m_colorfill_items.size();
+            m_report.duplicate_count += m_duplicate_indices.size();
+            if (m_atlases.size() > current_atlas_count) {
+                const size_t pixel_size = m_atlases.back().pixel_size();
+
+                // Duplicates would take as many pixels as their preprocessed source, split source takes its parts
+                std::unordered_map<size_t, size_t> part_pixels;
+                for (auto iter = m_part_owners.begin(); iter != m_part_owners.end(); ++iter) {
+                    const Item& part = m_items[iter->first];
+                    part_pixels[iter->second] += (size_t) part.width() * part.height();
+                }
+
+                for (auto iter = m_duplicate_indices.begin(); iter != m_duplicate_indices.end(); ++iter) {
+                    const Item& source = items[iter->second];
+                    if (source.status() == Item::Status::Skipped)
+                        continue;
+
+                    auto parts = part_pixels.find(iter->second);
+                    const size_t pixels =
+                        parts != part_pixels.end() ? parts->second : (size_t) source.width() * source.height();
+                    m_report.duplicate_bytes += pixels * pixel_size;
+                }
+            }
+
+            for (auto iter = m_part_owners.begin(); iter != m_part_owners.end(); ++iter) {
+                Item& part = m_items[iter->first];
+                Item& owner = items[iter->second];
+
+                Item::Part& result = owner.parts.emplace_back();
+                result.texture_index = part.texture_index;
+                result.vertices = part.vertices;
+                result.transform = part.transform;
+            }
+
             for (auto iter = m_duplicate_indices.begin(); iter != m_duplicate_indices.end(); ++iter) {
                 size_t desination_index = iter->first;
                 size_t source_index = iter->second;
 
                 Item& destination = items[desination_index];
-                Item& source = m_items[source_index];
+                Item& source = items[source_index];
+
+                if (source.status() == Item::Status::Skipped) {
+                    auto failure =
+                        std::find_if(m_failures.begin(), m_failures.end(), [source_index](const ItemFailure& other) {
+                            return other.index == source_index;
+                        });
+
+                    m_failures.push_back({desination_index, failure->reason});
+                    destination.mark_as_skipped();
+                    continue;
+                }
 
                 destination.texture_index = source.texture_index;
                 destination.vertices = source.vertices;
                 destination.transform = source.transform;
+                destination.parts = source.parts;
             }
 
-            m_duplicate_indices.clear();
-            m_items.clear();
+            release_state(false);
 
             return m_atlases.size() - current_atlas_count;
         }
 
+        // Collects failure of item with partial success policy, throws it with Throw policy
+        void record_failure(size_t index, PackagingException::Reason reason);
+
+        // Removes items with failed source indices from current run, including parts of split items
+        void drop_failed_items(const std::set<size_t>& failed_items, Container<size_t>& item_indices);
+
+        // Replaces colorfill items by palette items with a cell for each color.
+        // Colors that do not fit into one page are split between several palettes
+        void build_palette(Container<size_t>& item_indices);
+
+        // Points colorfill items to their cells in packed palettes
+        void assign_palette_cells();
+
+        // Count of palette cells in columns and rows that fit into page with extrusion and block padding
+        Point palette_grid() const;
+
+        // Generates item polygon or takes it from shared cache
+        void generate_polygon(Item& item, size_t index);
+
         bool pack_items(Image::PixelDepth atlas_type);
 
+        void generate_scaled_atlases(size_t atlas_offset);
+
+        // Size of items extrusion in main atlases. With multi-scale output it is enlarged,
+        // so every item keeps its extrusion and gaps between items in smallest atlases
+        uint16_t extrude_size() const;
+
+        // Multiple for page size, so downsampled pages cover the same area
+        uint16_t scale_divisor() const;
+
+        // Final atlas size for area used by packed items, in packer units
+        Image::Size page_size(int64_t used_width, int64_t used_height) const;
+
+        // Replaces items with separated opaque regions by their parts
+        void split_islands(Container<size_t>& item_indices);
+
+        // Replaces items that do not fit into page by their tiles.
+        // Returns indices of items that do not fit and can not be tiled, they are removed from current run
+        std::set<size_t> split_tiles(Container<size_t>& item_indices);
+
+        // Replaces items of current run that have non empty list of parts by these parts
+        void replace_by_parts(Container<Container<Item>>& parts, Container<size_t>& item_indices);
+
+        // Throws PackagingException with Cancelled reason if cancellation was requested
+        void check_cancelled() const;
+
+        // Frees state of current run. Atlases are dropped too if run was cancelled
+        void release_state(bool drop_atlases);
+
+        // Extends placed image by its edge pixels up to block boundaries
+        void fill_block_padding(size_t atlas_index,
+                                uint16_t x,
+                                uint16_t y,
+                                uint16_t width,
+                                uint16_t height,
+                                uint16_t cell_width,
+                                uint16_t cell_height);
+
+        // Accounts placed item in report
+        void report_item(const Item& item, const RawImage& image);
+
+        // Fills texel statistics of atlases starting from given index
+        void report_pages(size_t atlas_offset);
+
     public:
-        void place_image_to(RawImageRef src, size_t atlas_index, uint16_t x, uint16_t y, Item::FixedRotation rotation);
+        void place_image_to(
+            const RawImage& src, size_t atlas_index, uint16_t x, uint16_t y, Item::FixedRotation rotation);
 
         static bool validate_image(const RawImage& image);
 
     private:
         const Config m_config;
+        const Config::Snapshot m_snapshot;
+        Ref<ThreadPool> m_pool;
+        Ref<PolygonCache> m_cache;
+        Ref<BufferManager> m_buffers;
+
+        Ref<ResultCache> m_result_cache;
+        uint64_t m_result_salt = 0;
+
+        // Index of first atlas of current run
+        size_t m_result_offset = 0;
 
         Container<std::reference_wrapper<Item>> m_items;
         std::unordered_map<size_t, size_t> m_duplicate_indices;
 
+        // Storage for parts of split items and their source item indices
+        std::deque<Item> m_part_items;
+        std::map<size_t, size_t> m_part_owners;
+
+        // Palettes of current run and colorfill items in order of their cells
+        Container<Ref<Item>> m_palettes;
+        Container<std::reference_wrapper<Item>> m_colorfill_items;
+
         Container<RawImage> m_atlases;
+        Container<Container<RawImage>> m_scaled_atlases;
+
+        PackingReport m_report;
+        Container<ItemFailure> m_failures;
+
+        std::atomic<size_t> m_item_counter = 0;
+        std::atomic<size_t> m_duplicate_item_counter = 0;
+        std::atomic<size_t> m_total_item_counter = 0;
 
-        size_t m_item_counter = 0;
-        size_t m_duplicate_item_counter = 0;
+        std::atomic<bool> m_cancelled = false;
     };
 }
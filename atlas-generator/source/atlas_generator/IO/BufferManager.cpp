@@ -0,0 +1,129 @@
+#include "BufferManager.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace wk::AtlasGenerator {
+    BufferManager::BufferManager(size_t budget, std::filesystem::path directory) :
+        m_budget(budget),
+        m_directory(directory) {
+    }
+
+    void BufferManager::reserve(size_t bytes) {
+        std::lock_guard lock(m_mutex);
+
+        m_reserved += bytes;
+        m_peak = std::max(m_peak, m_resident + m_reserved);
+        evict_locked(nullptr);
+    }
+
+    void BufferManager::release(size_t bytes) {
+        std::lock_guard lock(m_mutex);
+
+        m_reserved -= std::min(bytes, m_reserved);
+    }
+
+    void BufferManager::track(Item& item) {
+        std::lock_guard lock(m_mutex);
+
+        track_locked(item);
+    }
+
+    const RawImage& BufferManager::acquire(Item& item) {
+        std::lock_guard lock(m_mutex);
+
+        const RawImage& image = item.image();
+        track_locked(item);
+
+        return image;
+    }
+
+    void BufferManager::clear() {
+        std::lock_guard lock(m_mutex);
+
+        m_order.clear();
+        m_entries.clear();
+        m_resident = 0;
+    }
+
+    size_t BufferManager::resident() const {
+        std::lock_guard lock(m_mutex);
+        return m_resident + m_reserved;
+    }
+
+    size_t BufferManager::peak() const {
+        std::lock_guard lock(m_mutex);
+        return m_peak;
+    }
+
+    size_t BufferManager::evicted() const {
+        std::lock_guard lock(m_mutex);
+        return m_evicted;
+    }
+
+    void BufferManager::track_locked(Item& item) {
+        if (item.is_spilled())
+            return;
+
+        auto it = m_entries.find(&item);
+        if (it != m_entries.end()) {
+            m_order.splice(m_order.end(), m_order, it->second.position);
+            return;
+        }
+
+        Entry& entry = m_entries[&item];
+        entry.position = m_order.insert(m_order.end(), &item);
+        entry.bytes = item.image().data_length();
+
+        m_resident += entry.bytes;
+        m_peak = std::max(m_peak, m_resident + m_reserved);
+        evict_locked(&item);
+    }
+
+    void BufferManager::evict_locked(const Item* keep) {
+        if (!m_budget)
+            return;
+
+        while (m_resident + m_reserved > m_budget && !m_order.empty() && m_order.front() != keep) {
+            Item* item = m_order.front();
+            m_order.pop_front();
+
+            auto it = m_entries.find(item);
+            m_resident -= it->second.bytes;
+            m_entries.erase(it);
+
+            if (!m_file) {
+                m_file = CreateRef<ScratchFile>(m_directory);
+            }
+
+            // Shared pixels stay in memory anyway, such items are just not tracked anymore
+            m_evicted += item->spill(m_file);
+        }
+    }
+
+    size_t BufferManager::peak_rss() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return (size_t) counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+
+#if defined(__APPLE__)
+        return (size_t) usage.ru_maxrss;
+#else
+        // Linux reports kilobytes
+        return (size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ScratchFile.h"
+#include "atlas_generator/Item/Item.h"
+
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <stddef.h>
+#include <unordered_map>
+
+namespace wk::AtlasGenerator {
+    // Keeps pixels of processed items within memory budget.
+    // Pixels of least recently used items are evicted to scratch file and loaded back on access
+    class BufferManager {
+    public:
+        /// @param budget Memory budget in bytes, 0 means unlimited
+        /// @param directory Folder for scratch file, system temporary folder if empty
+        BufferManager(size_t budget = 0, std::filesystem::path directory = {});
+
+    public:
+        /// @brief Accounts memory that can not be evicted, e.g. atlas pages
+        void reserve(size_t bytes);
+
+        /// @brief Returns memory accounted by reserve
+        void release(size_t bytes);
+
+        /// @brief Starts tracking of item pixels or marks them as recently used. Other items may be evicted
+        void track(Item& item);
+
+        /// @brief Loads pixels of item if they were evicted and marks them as recently used
+        const RawImage& acquire(Item& item);
+
+        /// @brief Stops tracking of all items. Evicted items keep their pixels in scratch file until accessed
+        void clear();
+
+        size_t budget() const { return m_budget; };
+
+        // Bytes of tracked pixels and reserved memory that are in memory now
+        size_t resident() const;
+
+        // The highest resident value since creation
+        size_t peak() const;
+
+        // Total bytes that were moved to scratch file
+        size_t evicted() const;
+
+        /// @brief Peak resident set size of whole process in bytes, 0 if platform does not report it
+        static size_t peak_rss();
+
+    private:
+        struct Entry {
+            std::list<Item*>::iterator position;
+            size_t bytes = 0;
+        };
+
+        void track_locked(Item& item);
+        void evict_locked(const Item* keep);
+
+    private:
+        const size_t m_budget;
+        const std::filesystem::path m_directory;
+        Ref<ScratchFile> m_file;
+
+        mutable std::mutex m_mutex;
+
+        // Tracked resident items from the least recently used one
+        std::list<Item*> m_order;
+        std::unordered_map<const Item*, Entry> m_entries;
+
+        size_t m_resident = 0;
+        size_t m_reserved = 0;
+        size_t m_peak = 0;
+        size_t m_evicted = 0;
+    };
+}
@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#include "core/exception/exception.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wk::AtlasGenerator {
+#if defined(_WIN32)
+    MappedFile::MappedFile(const std::filesystem::path& path) {
+        m_file = CreateFileW(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            m_file = nullptr;
+            throw wk::Exception("Failed to open file for mapping");
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = (size_t) size.QuadPart;
+        if (!m_size)
+            return;
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (m_mapping) {
+            m_data = (uint8_t*) MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+        }
+
+        if (!m_data) {
+            if (m_mapping) {
+                CloseHandle(m_mapping);
+            }
+            CloseHandle(m_file);
+            throw wk::Exception("Failed to map file");
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+        if (m_file) {
+            CloseHandle(m_file);
+        }
+    }
+#else
+    MappedFile::MappedFile(const std::filesystem::path& path) {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw wk::Exception("Failed to open file for mapping");
+        }
+
+        struct stat info;
+        if (fstat(descriptor, &info) != 0) {
+            close(descriptor);
+            throw wk::Exception("Failed to read file size");
+        }
+
+        m_size = (size_t) info.st_size;
+        if (m_size) {
+            void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+            if (data == MAP_FAILED) {
+                close(descriptor);
+                throw wk::Exception("Failed to map file");
+            }
+
+            m_data = (uint8_t*) data;
+        }
+
+        // Mapping stays valid after descriptor is closed
+        close(descriptor);
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+    }
+#endif
+}
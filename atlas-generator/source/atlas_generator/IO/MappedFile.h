@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace wk::AtlasGenerator {
+    // Private copy-on-write mapping of file. Data can be modified in memory, file itself is never changed
+    class MappedFile {
+    public:
+        /// @brief Maps whole file, throws wk::Exception if file can not be mapped
+        MappedFile(const std::filesystem::path& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+    public:
+        uint8_t* data() const { return m_data; };
+        size_t size() const { return m_size; };
+
+    private:
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+
+#if defined(_WIN32)
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,64 @@
+#include "ScratchFile.h"
+
+#include "core/exception/exception.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace wk::AtlasGenerator {
+    ScratchFile::ScratchFile(std::filesystem::path directory) {
+        static std::atomic<uint32_t> counter = 0;
+
+        if (directory.empty()) {
+            directory = std::filesystem::temp_directory_path();
+        }
+
+        // Time and counter keep names unique between processes and instances
+        const auto time = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_path = directory / ("atlas_generator_" + std::to_string(time) + "_" + std::to_string(counter++) + ".scratch");
+
+        m_stream.open(m_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!m_stream.is_open()) {
+            throw wk::Exception("Failed to create scratch file");
+        }
+    }
+
+    ScratchFile::~ScratchFile() {
+        m_stream.close();
+
+        std::error_code error;
+        std::filesystem::remove(m_path, error);
+    }
+
+    uint64_t ScratchFile::write(const uint8_t* data, size_t length) {
+        std::lock_guard lock(m_mutex);
+
+        const uint64_t offset = m_size;
+        m_stream.seekp((std::streamoff) offset);
+        m_stream.write((const char*) data, (std::streamsize) length);
+        if (!m_stream) {
+            throw wk::Exception("Failed to write scratch file");
+        }
+
+        m_size += length;
+        return offset;
+    }
+
+    void ScratchFile::read(uint64_t offset, uint8_t* data, size_t length) {
+        std::lock_guard lock(m_mutex);
+
+        m_stream.seekg((std::streamoff) offset);
+        m_stream.read((char*) data, (std::streamsize) length);
+        if (!m_stream) {
+            throw wk::Exception("Failed to read scratch file");
+        }
+    }
+
+    RawImageRef SpilledImage::load() const {
+        RawImageRef image = CreateRef<RawImage>(width, height, depth, colorspace);
+        file->read(offset, image->data(), image->data_length());
+
+        return image;
+    }
+}
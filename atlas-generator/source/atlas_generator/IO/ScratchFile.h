@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/image/raw_image.h"
+#include "core/memory/ref.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+namespace wk::AtlasGenerator {
+    // Temporary file for data evicted from memory. File is removed with the last reference to it
+    class ScratchFile {
+    public:
+        /// @brief Creates file with unique name, throws wk::Exception if file can not be created
+        /// @param directory Folder for file, system temporary folder if empty
+        ScratchFile(std::filesystem::path directory = {});
+        ~ScratchFile();
+
+        ScratchFile(const ScratchFile&) = delete;
+        ScratchFile& operator=(const ScratchFile&) = delete;
+
+    public:
+        /// @brief Appends data to the end of file
+        /// @return Offset of written data
+        uint64_t write(const uint8_t* data, size_t length);
+        void read(uint64_t offset, uint8_t* data, size_t length);
+
+        uint64_t size() const { return m_size; };
+
+    private:
+        std::filesystem::path m_path;
+        std::fstream m_stream;
+        std::mutex m_mutex;
+        uint64_t m_size = 0;
+    };
+
+    // Image pixels stored in scratch file
+    struct SpilledImage {
+        Ref<ScratchFile> file;
+        uint64_t offset = 0;
+
+        uint16_t width = 0;
+        uint16_t height = 0;
+        Image::PixelDepth depth;
+        Image::ColorSpace colorspace;
+
+        // Image that was loaded from file last time. While it is alive its pixels match stored ones
+        std::weak_ptr<RawImage> restored;
+
+        // Const getters of items reload pixels lazily, so reload and reads of item image are done under this lock
+        std::mutex mutex;
+
+        RawImageRef load() const;
+    };
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "atlas_generator/Config.h"
+#include "atlas_generator/Item/Item.h"
+#include "core/image/raw_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+// Pixel loops specialized per pixel depth at compile time.
+// Depth is dispatched once per image, so inner loops have fixed pixel size and no format branches
+namespace wk::AtlasGenerator::Kernels {
+    template <Image::PixelDepth Depth>
+    struct PixelFormat;
+
+    template <>
+    struct PixelFormat<Image::PixelDepth::RGBA8> {
+        static constexpr uint8_t Size = 4;
+        static constexpr uint8_t Colors = 3;
+        static constexpr bool HasAlpha = true;
+    };
+
+    template <>
+    struct PixelFormat<Image::PixelDepth::RGB8> {
+        static constexpr uint8_t Size = 3;
+        static constexpr uint8_t Colors = 3;
+        static constexpr bool HasAlpha = false;
+    };
+
+    template <>
+    struct PixelFormat<Image::PixelDepth::LUMINANCE8_ALPHA8> {
+        static constexpr uint8_t Size = 2;
+        static constexpr uint8_t Colors = 1;
+        static constexpr bool HasAlpha = true;
+    };
+
+    template <>
+    struct PixelFormat<Image::PixelDepth::LUMINANCE8> {
+        static constexpr uint8_t Size = 1;
+        static constexpr uint8_t Colors = 1;
+        static constexpr bool HasAlpha = false;
+    };
+
+    /// @brief Calls function with PixelFormat of given depth as argument
+    /// @return False if depth has no specialized kernels
+    template <typename F>
+    bool dispatch(Image::PixelDepth depth, F&& function) {
+        switch (depth) {
+            case Image::PixelDepth::RGBA8:
+                function(PixelFormat<Image::PixelDepth::RGBA8>{});
+                return true;
+            case Image::PixelDepth::RGB8:
+                function(PixelFormat<Image::PixelDepth::RGB8>{});
+                return true;
+            case Image::PixelDepth::LUMINANCE8_ALPHA8:
+                function(PixelFormat<Image::PixelDepth::LUMINANCE8_ALPHA8>{});
+                return true;
+            case Image::PixelDepth::LUMINANCE8:
+                function(PixelFormat<Image::PixelDepth::LUMINANCE8>{});
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// @brief Writes binary mask of pixels with alpha above threshold
+    /// @param mask Single channel image with the same size as source
+    template <typename Format>
+    void alpha_mask(const RawImage& image, uint8_t threshold, RawImage& mask) {
+        static_assert(Format::HasAlpha, "Format has no alpha channel");
+
+        const uint16_t width = image.width();
+        for (uint16_t h = 0; image.height() > h; h++) {
+            const uint8_t* alpha = image.at(0, h) + Format::Colors;
+            uint8_t* output = mask.at(0, h);
+
+            for (uint16_t w = 0; width > w; w++, alpha += Format::Size) {
+                output[w] = *alpha > threshold ? 0xFF : 0x00;
+            }
+        }
+    }
+
+    /// @brief Counts pixels with alpha above threshold. All pixels are counted for formats without alpha
+    template <typename Format>
+    size_t count_opaque(const RawImage& image, uint8_t threshold) {
+        const size_t count = (size_t) image.width() * image.height();
+        if constexpr (!Format::HasAlpha) {
+            return count;
+        } else {
+            const uint8_t* alpha = image.data() + Format::Colors;
+
+            size_t result = 0;
+            for (size_t i = 0; count > i; i++, alpha += Format::Size) {
+                result += *alpha > threshold;
+            }
+
+            return result;
+        }
+    }
+
+    /// @brief Multiplies color channels by alpha. Destination can be the same image as source
+    template <typename Format>
+    void premultiply(const RawImage& src, RawImage& dst) {
+        const size_t length = (size_t) src.width() * src.height() * Format::Size;
+        const uint8_t* input = src.data();
+        uint8_t* output = dst.data();
+
+        if constexpr (!Format::HasAlpha) {
+            if (input != output) {
+                std::memcpy(output, input, length);
+            }
+        } else {
+            for (size_t i = 0; length > i; i += Format::Size) {
+                const uint8_t a = input[i + Format::Colors];
+                const float alpha = (float) a / 255.f;
+
+                for (uint8_t c = 0; Format::Colors > c; c++) {
+                    output[i + c] = (uint8_t) (input[i + c] * alpha);
+                }
+                output[i + Format::Colors] = a;
+            }
+        }
+    }
+
+    /// @brief Copies image with extrusion of its edges to atlas, applying fixed rotation.
+    /// Pixels with alpha below threshold are skipped
+    /// @param x Position of extruded image on atlas
+    /// @param y Position of extruded image on atlas
+    template <typename Format>
+    void blit_extruded(const RawImage& image,
+                       RawImage& atlas,
+                       int32_t x,
+                       int32_t y,
+                       Item::FixedRotation rotation,
+                       const Config::Snapshot& config,
+                       uint16_t extrude) {
+        const int32_t width = image.width() + extrude * 2;
+        const int32_t height = image.height() + extrude * 2;
+        const int32_t last_x = width - 1;
+        const int32_t last_y = height - 1;
+
+        // Destination position is linear function of extruded image position: origin + w * step_w + h * step_h
+        int32_t origin_x = x, origin_y = y;
+        int32_t step_wx = 1, step_wy = 0, step_hx = 0, step_hy = 1;
+        switch (rotation) {
+            case Item::Rotation90:
+                origin_x += last_y;
+                step_wx = 0, step_wy = 1, step_hx = -1, step_hy = 0;
+                break;
+            case Item::Rotation180:
+                origin_x += last_x;
+                origin_y += last_y;
+                step_wx = -1, step_wy = 0, step_hx = 0, step_hy = -1;
+                break;
+            case Item::Rotation270:
+                origin_y += last_x;
+                step_wx = 0, step_wy = -1, step_hx = 1, step_hy = 0;
+                break;
+            default:
+                break;
+        }
+
+        const int32_t atlas_width = atlas.width();
+        const int32_t atlas_height = atlas.height();
+        const int32_t src_right = image.width() - 1;
+        const int32_t src_bottom = image.height() - 1;
+
+        for (int32_t h = 0; height > h; h++) {
+            // Extruded pixels repeat nearest edge pixel of source
+            const int32_t src_y = std::clamp(h - (int32_t) extrude, 0, src_bottom);
+            const uint8_t* row = image.at(0, (uint16_t) src_y);
+
+            int32_t dst_x = origin_x + h * step_hx;
+            int32_t dst_y = origin_y + h * step_hy;
+            for (int32_t w = 0; width > w; w++, dst_x += step_wx, dst_y += step_wy) {
+                if (0 > dst_x || dst_x >= atlas_width || 0 > dst_y || dst_y >= atlas_height)
+                    continue;
+
+                const int32_t src_x = std::clamp(w - (int32_t) extrude, 0, src_right);
+                const uint8_t* pixel = row + (size_t) src_x * Format::Size;
+
+                if constexpr (Format::HasAlpha) {
+                    if (config.alpha_threshold > pixel[Format::Colors])
+                        continue;
+                }
+
+                std::memcpy(atlas.at((uint16_t) dst_x, (uint16_t) dst_y), pixel, Format::Size);
+            }
+        }
+    }
+}
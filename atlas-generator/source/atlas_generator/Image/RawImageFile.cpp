@@ -0,0 +1,118 @@
+#include "RawImageFile.h"
+
+#include "atlas_generator/IO/MappedFile.h"
+#include "core/exception/exception.h"
+
+#include <cstring>
+#include <fstream>
+#include <optional>
+
+namespace wk::AtlasGenerator {
+    namespace {
+        constexpr char Magic[4] = {'W', 'K', 'R', 'I'};
+        constexpr uint16_t Version = 1;
+
+#pragma pack(push, 1)
+        struct Header {
+            char magic[4];
+            uint16_t version;
+            uint16_t width;
+            uint16_t height;
+            uint8_t depth;
+            uint8_t colorspace;
+            uint8_t reserved[4];
+        };
+#pragma pack(pop)
+
+        static_assert(sizeof(Header) == 16);
+
+        // Keeps file mapped while image is used
+        struct MappedImage {
+            MappedImage(const std::filesystem::path& path) :
+                file(path) {
+            }
+
+            MappedFile file;
+            std::optional<RawImage> image;
+        };
+    }
+
+    bool is_raw_image_file(const std::filesystem::path& path) {
+        return path.extension() == RawImageExtension;
+    }
+
+    RawImageRef load_raw_image(const std::filesystem::path& path) {
+        Ref<MappedImage> mapped = CreateRef<MappedImage>(path);
+        const MappedFile& file = mapped->file;
+
+        if (sizeof(Header) > file.size()) {
+            throw wk::Exception("Raw image file is too small");
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+            throw wk::Exception("Unknown raw image file format");
+        }
+
+        if (!stored_pixel_size(header.depth) || !is_stored_colorspace(header.colorspace)) {
+            throw wk::Exception("Raw image file has unsupported pixel format");
+        }
+
+        const RawImage& image = mapped->image.emplace(file.data() + sizeof(Header),
+                                                      header.width,
+                                                      header.height,
+                                                      (Image::PixelDepth) header.depth,
+                                                      (Image::ColorSpace) header.colorspace);
+
+        if (sizeof(Header) + image.data_length() > file.size()) {
+            throw wk::Exception("Raw image file is damaged");
+        }
+
+        // Image shares ownership of mapping
+        return RawImageRef(mapped, &mapped->image.value());
+    }
+
+    void write_raw_image(const std::filesystem::path& path, const RawImage& image) {
+        Header header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.width = image.width();
+        header.height = image.height();
+        header.depth = (uint8_t) image.depth();
+        header.colorspace = (uint8_t) image.colorspace();
+
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*) &header, sizeof(Header));
+
+        const size_t row_length = (size_t) image.width() * image.pixel_size();
+        for (uint16_t h = 0; image.height() > h; h++) {
+            file.write((const char*) image.at(0, h), row_length);
+        }
+    }
+
+    uint8_t stored_pixel_size(uint8_t depth) {
+        switch ((Image::PixelDepth) depth) {
+            case Image::PixelDepth::RGBA8:
+                return 4;
+            case Image::PixelDepth::RGB8:
+                return 3;
+            case Image::PixelDepth::LUMINANCE8_ALPHA8:
+                return 2;
+            case Image::PixelDepth::LUMINANCE8:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    bool is_stored_colorspace(uint8_t colorspace) {
+        switch ((Image::ColorSpace) colorspace) {
+            case Image::ColorSpace::Linear:
+            case Image::ColorSpace::sRGB:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
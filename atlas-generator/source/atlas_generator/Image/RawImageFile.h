@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core/image/raw_image.h"
+
+#include <filesystem>
+
+namespace wk::AtlasGenerator {
+    // Uncompressed image container: 16 bytes header with image info followed by tightly packed pixel rows.
+    // Files are memory mapped, so no decoding is needed
+    constexpr const char* RawImageExtension = ".rawimg";
+
+    /// @brief Checks if file has raw image container extension
+    bool is_raw_image_file(const std::filesystem::path& path);
+
+    /// @brief Maps raw image container. Returned image uses mapped pixels directly and keeps mapping alive.
+    /// Throws wk::Exception if file is damaged or has unsupported pixel format
+    RawImageRef load_raw_image(const std::filesystem::path& path);
+
+    /// @brief Writes image to raw image container
+    void write_raw_image(const std::filesystem::path& path, const RawImage& image);
+
+    /// @brief Size of pixel of depths that stored images may have, 0 for other values.
+    /// Stored depth is checked by it before image is created, so data length can be trusted
+    uint8_t stored_pixel_size(uint8_t depth);
+
+    /// @brief Checks that stored color space has known value
+    bool is_stored_colorspace(uint8_t colorspace);
+}
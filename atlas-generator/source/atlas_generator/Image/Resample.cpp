@@ -0,0 +1,156 @@
+#include "Resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+namespace wk::AtlasGenerator {
+    namespace {
+        // Fixed point precision of filter weights
+        constexpr uint32_t WeightBits = 14;
+        constexpr uint32_t WeightOne = 1 << WeightBits;
+
+        // Precision of intermediate values after horizontal pass
+        constexpr uint32_t IntermediateBits = 8;
+
+        struct FilterTap {
+            uint32_t begin = 0;
+            uint32_t count = 0;
+            size_t weights = 0;
+        };
+
+        struct Filter {
+            std::vector<FilterTap> taps;
+            std::vector<uint32_t> weights;
+        };
+
+        void build_filter(uint32_t src_size, uint32_t dst_size, Filter& filter) {
+            filter.taps.resize(dst_size);
+            filter.weights.clear();
+            filter.weights.reserve((size_t) dst_size * 3);
+
+            const double ratio = (double) src_size / dst_size;
+            std::vector<double> coverage;
+
+            for (uint32_t i = 0; dst_size > i; i++) {
+                FilterTap& tap = filter.taps[i];
+                coverage.clear();
+
+                if (ratio >= 1.0) {
+                    // Area filter
+                    double begin = i * ratio;
+                    double end = std::min((i + 1) * ratio, (double) src_size);
+
+                    tap.begin = (uint32_t) begin;
+                    uint32_t last = std::min((uint32_t) std::ceil(end), src_size);
+                    for (uint32_t j = tap.begin; last > j; j++) {
+                        coverage.push_back(std::min(end, (double) j + 1) - std::max(begin, (double) j));
+                    }
+                } else {
+                    // Bilinear filter
+                    double center = std::max((i + 0.5) * ratio - 0.5, 0.0);
+                    uint32_t first = std::min((uint32_t) center, src_size - 1);
+                    double fraction = center - first;
+
+                    tap.begin = first;
+                    coverage.push_back(1.0 - fraction);
+                    if (src_size > first + 1) {
+                        coverage.push_back(fraction);
+                    }
+                }
+
+                double total = 0.0;
+                for (double value : coverage) {
+                    total += value;
+                }
+
+                // Weights are normalized so their sum is exactly WeightOne
+                tap.count = (uint32_t) coverage.size();
+                tap.weights = filter.weights.size();
+
+                uint32_t sum = 0;
+                size_t biggest = tap.weights;
+                for (double value : coverage) {
+                    uint32_t weight = (uint32_t) std::lround(value / total * WeightOne);
+                    if (filter.weights.size() == tap.weights || weight > filter.weights[biggest]) {
+                        biggest = filter.weights.size();
+                    }
+
+                    filter.weights.push_back(weight);
+                    sum += weight;
+                }
+
+                filter.weights[biggest] += WeightOne - sum;
+            }
+        }
+    }
+
+    bool can_resample(const RawImage& image) {
+        // Only formats with 8 bits per channel
+        return !image.is_complex() && image.pixel_size() == image.channels();
+    }
+
+    void resample(const RawImage& src, const Image::Bound& region, RawImage& dst) {
+        const uint32_t channels = src.channels();
+        const uint32_t src_width = (uint32_t) region.width;
+        const uint32_t src_height = (uint32_t) region.height;
+        const uint32_t dst_width = dst.width();
+        const uint32_t dst_height = dst.height();
+        const size_t dst_row = (size_t) dst_width * channels;
+
+        Filter horizontal_filter;
+        Filter vertical_filter;
+        build_filter(src_width, dst_width, horizontal_filter);
+        build_filter(src_height, dst_height, vertical_filter);
+
+        // Horizontal pass over all source rows of region
+        std::vector<uint16_t> intermediate(dst_row * src_height);
+        for (uint32_t h = 0; src_height > h; h++) {
+            const uint8_t* src_row = src.at((uint16_t) region.x, (uint16_t) (region.y + h));
+            uint16_t* row = &intermediate[dst_row * h];
+
+            for (uint32_t w = 0; dst_width > w; w++) {
+                const FilterTap& tap = horizontal_filter.taps[w];
+                const uint32_t* weights = &horizontal_filter.weights[tap.weights];
+                const uint8_t* pixels = src_row + (size_t) tap.begin * channels;
+
+                uint32_t accumulator[4] = {0, 0, 0, 0};
+                for (uint32_t i = 0; tap.count > i; i++) {
+                    for (uint32_t c = 0; channels > c; c++) {
+                        accumulator[c] += weights[i] * pixels[(size_t) i * channels + c];
+                    }
+                }
+
+                for (uint32_t c = 0; channels > c; c++) {
+                    constexpr uint32_t shift = WeightBits - IntermediateBits;
+                    row[(size_t) w * channels + c] = (uint16_t) ((accumulator[c] + (1 << (shift - 1))) >> shift);
+                }
+            }
+        }
+
+        // Vertical pass, rows are contiguous so inner loop is vectorized by compiler
+        std::vector<uint32_t> accumulator(dst_row);
+        for (uint32_t h = 0; dst_height > h; h++) {
+            const FilterTap& tap = vertical_filter.taps[h];
+            const uint32_t* weights = &vertical_filter.weights[tap.weights];
+
+            std::fill(accumulator.begin(), accumulator.end(), 0);
+            for (uint32_t i = 0; tap.count > i; i++) {
+                const uint16_t* row = &intermediate[dst_row * (tap.begin + i)];
+                const uint32_t weight = weights[i];
+
+                for (size_t x = 0; dst_row > x; x++) {
+                    accumulator[x] += weight * row[x];
+                }
+            }
+
+            constexpr uint32_t shift = WeightBits + IntermediateBits;
+            uint8_t* dst_pixels = dst.at(0, (uint16_t) h);
+            for (size_t x = 0; dst_row > x; x++) {
+                uint32_t value = (accumulator[x] + (1 << (shift - 1))) >> shift;
+                dst_pixels[x] = (uint8_t) std::min<uint32_t>(value, 255);
+            }
+        }
+    }
+}
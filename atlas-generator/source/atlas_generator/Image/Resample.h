@@ -0,0 +1,15 @@
+#pragma once
+
+#include "core/image/raw_image.h"
+
+namespace wk::AtlasGenerator {
+    /// @brief Checks if image can be processed by resample function
+    bool can_resample(const RawImage& image);
+
+    /// @brief Resizes region of source image to size of destination image.
+    /// Area filter is used for downscaling and bilinear filter for upscaling
+    /// @param src Source image
+    /// @param region Source image region
+    /// @param dst Destination image with the same pixel depth
+    void resample(const RawImage& src, const Image::Bound& region, RawImage& dst);
+}
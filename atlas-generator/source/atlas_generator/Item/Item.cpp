@@ -1,16 +1,35 @@
 #include "atlas_generator/Item/Item.h"
 
+#include "atlas_generator/Image/PixelKernels.h"
+#include "atlas_generator/Image/RawImageFile.h"
+#include "atlas_generator/Image/Resample.h"
+
 #include "core/asset_manager/asset_manager.h"
 #include "core/io/file_stream.h"
 #include "core/math/triangle.h"
 #include "core/stb/stb.h"
 
 #include <cmath>
+#include <cstring>
+#include <numeric>
 
 namespace wk::AtlasGenerator {
     Item::Item(const RawImage& image, bool sliced) :
         m_sliced(sliced),
-        m_image(wk::CreateRef<RawImage>(image)) {
+        m_image(wk::CreateRef<RawImage>(image.width(), image.height(), image.depth(), image.colorspace())) {
+        // Pixels are hashed in the same pass with copying, so deduplication does not read them again
+        m_hash = copy_hash128(image.data(), m_image->data(), image.data_length(), hash_seed(image));
+    }
+
+    Item::Item(RawImageRef image, bool sliced) :
+        m_sliced(sliced),
+        m_image(image) {
+    }
+
+    Item::Item(uint8_t* data, uint16_t width, uint16_t height, Image::PixelDepth depth, bool sliced) :
+        m_sliced(sliced),
+        m_image(wk::CreateRef<RawImage>(data, width, height, depth)),
+        m_borrowed(true) {
     }
 
     Item::Item(const ColorRGBA& color) :
@@ -20,6 +39,11 @@ namespace wk::AtlasGenerator {
 
     Item::Item(std::filesystem::path path, bool sliced) :
         m_sliced(sliced) {
+        if (is_raw_image_file(path)) {
+            m_image = load_raw_image(path);
+            return;
+        }
+
         auto& manager = wk::AssetManager::Instance();
 
         auto file = manager.load_file(path);
@@ -30,12 +54,77 @@ namespace wk::AtlasGenerator {
         return m_status;
     }
     uint16_t Item::width() const {
-        return (uint16_t) m_image->width();
+        if (m_spilled) {
+            std::lock_guard lock(m_spilled->mutex);
+            return m_image ? m_image->width() : m_spilled->width;
+        }
+
+        return m_image->width();
     };
     uint16_t Item::height() const {
-        return (uint16_t) m_image->height();
+        if (m_spilled) {
+            std::lock_guard lock(m_spilled->mutex);
+            return m_image ? m_image->height() : m_spilled->height;
+        }
+
+        return m_image->height();
     };
 
+    const RawImage& Item::image() const {
+        load_image();
+        return *m_image;
+    }
+
+    const RawImageRef& Item::image_ref() const {
+        load_image();
+        return m_image;
+    }
+
+    size_t Item::spill(const Ref<ScratchFile>& file) {
+        if (!m_image || is_image_shared())
+            return 0;
+
+        // Pixels that were loaded from scratch file and were not replaced since are already stored
+        if (!m_spilled || m_spilled->restored.lock() != m_image) {
+            Ref<SpilledImage> spilled = CreateRef<SpilledImage>();
+            spilled->file = file;
+            spilled->width = m_image->width();
+            spilled->height = m_image->height();
+            spilled->depth = m_image->depth();
+            spilled->colorspace = m_image->colorspace();
+            spilled->offset = file->write(m_image->data(), m_image->data_length());
+
+            m_spilled = spilled;
+        }
+
+        const size_t length = m_image->data_length();
+
+        std::lock_guard lock(m_spilled->mutex);
+        m_image = nullptr;
+        return length;
+    }
+
+    bool Item::is_spilled() const {
+        if (!m_spilled)
+            return false;
+
+        std::lock_guard lock(m_spilled->mutex);
+        return !m_image;
+    }
+
+    void Item::load_image() const {
+        if (!m_spilled)
+            return;
+
+        // Several threads may read the same spilled item, pixels are loaded by the first one
+        std::lock_guard lock(m_spilled->mutex);
+        if (m_image)
+            return;
+
+        m_image = m_spilled->load();
+        m_spilled->restored = m_image;
+    }
+
     bool Item::is_rectangle() const {
         if (is_sliced())
             return true;
@@ -68,38 +157,88 @@ namespace wk::AtlasGenerator {
         return true;
     }
 
-    void Item::generate_image_polygon(const Config& config) {
-        using namespace wk::Geometry;
+    void Item::mark_as_skipped() {
+        m_status = Status::Skipped;
+        vertices.clear();
+        parts.clear();
+    }
 
-        float scale_factor = is_sliced() ? 1.0f : 1.f / config.scale();
-        Image::Size full_size = m_image->size();
-        Image::Size current_size = full_size;
-        PointF crop_offset(0.0f, 0.0f);
+    Point Item::colorfill_size(const Config& config) const {
+        if (m_colorfill_size.x && m_colorfill_size.y)
+            return m_colorfill_size;
 
-        auto fallback_rectangle = [&] {
-            vertices.resize(4);
+        const int32_t size = std::max((int32_t) (1.f / config.scale()), 1);
+        return Point(size, size);
+    }
 
-            uint16_t x1 = (uint16_t) (crop_offset.x * scale_factor);
-            uint16_t y1 = (uint16_t) (crop_offset.y * scale_factor);
+    void Item::detect_uniform(const Config& config) {
+        load_image();
+        if (m_status != Status::Unset || m_preprocessed || m_colorfill)
+            return;
 
-            uint16_t x2 = (uint16_t) ((crop_offset.x + current_size.x) * scale_factor);
-            uint16_t y2 = (uint16_t) ((crop_offset.y + current_size.y) * scale_factor);
+        const RawImage& image = *m_image;
+        const uint16_t image_width = image.width();
+        const uint16_t image_height = image.height();
+        const uint8_t pixel_size = image.pixel_size();
+        if (!image_width || !image_height)
+            return;
 
-            uint16_t u = (uint16_t) current_size.x;
-            uint16_t v = (uint16_t) current_size.y;
+        const uint8_t channels = image.channels();
+        if (channels == 2 || channels == 4) {
+            const uint8_t threshold = config.alpha_threshold();
+            bool transparent = true;
 
-            vertices[3].uv = {0, 0};
-            vertices[2].uv = {0, v};
-            vertices[1].uv = {u, v};
-            vertices[0].uv = {u, 0};
+            for (uint16_t h = 0; image_height > h && transparent; h++) {
+                const uint8_t* alpha = image.at(0, h) + pixel_size - 1;
 
-            vertices[3].xy = {x1, y1};
-            vertices[2].xy = {x1, y2};
-            vertices[1].xy = {x2, y2};
-            vertices[0].xy = {x2, y1};
+                for (uint16_t w = 0; image_width > w; w++, alpha += pixel_size) {
+                    if (*alpha > threshold) {
+                        transparent = false;
+                        break;
+                    }
+                }
+            }
 
-            m_status = Status::Valid;
-        };
+            if (transparent) {
+                m_status = Status::Empty;
+                vertices.clear();
+                return;
+            }
+        }
+
+        // Each row is compared with row filled by first pixel, memcmp is vectorized well
+        const size_t row_length = (size_t) image_width * pixel_size;
+        Container<uint8_t> row(row_length);
+        for (size_t offset = 0; row_length > offset; offset += pixel_size) {
+            Memory::copy(image.at(0, 0), row.data() + offset, pixel_size);
+        }
+
+        for (uint16_t h = 0; image_height > h; h++) {
+            if (std::memcmp(image.at(0, h), row.data(), row_length) != 0)
+                return;
+        }
+
+        RawImageRef color = CreateRef<RawImage>(1, 1, image.depth(), image.colorspace());
+        Memory::copy(image.at(0, 0), color->data(), pixel_size);
+
+        m_colorfill_size = Point(image_width, image_height);
+        m_image = color;
+        m_borrowed = false;
+        m_colorfill = true;
+        m_hash.reset();
+    }
+
+    void Item::generate_image_polygon(const Config& config) {
+        load_image();
+        using namespace wk::Geometry;
+
+        float scale_factor = is_sliced() ? 1.0f : 1.f / config.scale();
+        Image::Size full_size = m_image->size();
+        Image::Size current_size = full_size;
+        PointF crop_offset(0.0f, 0.0f);
+
+        auto fallback_rectangle = [&] { set_rectangle(config, crop_offset, current_size); };
+        m_rectangle_polygon = false;
         image_preprocess(config);
 
         if (1 >= width() || 1 >= height()) {
@@ -107,20 +246,11 @@ namespace wk::AtlasGenerator {
             return;
         }
 
-        RawImageRef alpha_mask;
-        switch (m_image->channels()) {
-            case 4:
-                m_image->extract_channel(alpha_mask, 3);
-                break;
-            case 2:
-                m_image->extract_channel(alpha_mask, 1);
-                break;
-            default:
-                fallback_rectangle();
-                return;
+        RawImageRef alpha_mask = create_alpha_mask(config.alpha_threshold());
+        if (!alpha_mask) {
+            fallback_rectangle();
+            return;
         }
-
-        normalize_mask(alpha_mask, config);
         Image::Bound crop_bound = alpha_mask->bound();
         if (crop_bound.width <= 0)
             crop_bound.width = 1;
@@ -134,9 +264,11 @@ namespace wk::AtlasGenerator {
         }
 
         current_size = alpha_mask->size();
-        crop_offset = PointF(crop_bound.x * scale_factor, crop_bound.y * scale_factor);
+        crop_offset = PointF((float) crop_bound.x, (float) crop_bound.y);
+        m_crop_offset = crop_offset;
 
-        if (is_rectangle()) {
+        // Corners can't be cut when budget has no vertices for them
+        if (is_rectangle() || MinVertexBudget >= config.vertex_budget()) {
             fallback_rectangle();
             return;
         } else {
@@ -145,7 +277,9 @@ namespace wk::AtlasGenerator {
         }
 
         Container<Point> polygon;
-        {
+        if ((size_t) current_size.x * current_size.y >= CoarseHullMinArea) {
+            polygon = coarse_mask_hull(*alpha_mask);
+        } else {
             Container<Point> contour;
             get_image_contour(dilate_mask(alpha_mask), contour);
 
@@ -154,6 +288,7 @@ namespace wk::AtlasGenerator {
         }
 
         Container<Triangle> triangles;
+        Container<float> cut_depths;
         triangles.reserve(4);
 
         Point centroid = {static_cast<int>(abs(static_cast<float>(current_size.x) / 2)),
@@ -162,7 +297,8 @@ namespace wk::AtlasGenerator {
         float distance_threshold = (current_size.x + current_size.y) * 0.03f;
 
         auto calculate_triangle =
-            [&centroid, &current_size, &polygon, &triangles, &distance_threshold, this](Point input_point) {
+            [&centroid, &current_size, &polygon, &triangles, &cut_depths, &distance_threshold, this](
+                Point input_point) {
                 LineF ray(PointF((float) input_point.x, (float) input_point.y),
                           PointF((float) centroid.x, (float) centroid.y));
 
@@ -176,12 +312,9 @@ namespace wk::AtlasGenerator {
                 const Point& p2 = polygon[p2_idx];
 
                 // Skip processing if distance between corner and intersect point is too smol
-                {
-                    float distance = dist(input_point, intersect);
-
-                    if (distance_threshold > distance) {
-                        return;
-                    }
+                float distance = dist(input_point, intersect);
+                if (distance_threshold > distance) {
+                    return;
                 }
 
                 float angle = line_angle(Line(p1, p2));
@@ -191,6 +324,7 @@ namespace wk::AtlasGenerator {
                 Triangle cutoff = build_triangle(cutoff_bisector, angle, (current_size.x + current_size.y) * 2);
 
                 triangles.push_back(cutoff);
+                cut_depths.push_back(distance);
             };
 
         calculate_triangle(Point(0, 0));
@@ -198,6 +332,22 @@ namespace wk::AtlasGenerator {
         calculate_triangle(Point(current_size.x, current_size.y));
         calculate_triangle(Point(0, current_size.y));
 
+        // Each cut corner adds one vertex, only the deepest cuts fit into vertex budget
+        const size_t max_cuts = config.vertex_budget() - MinVertexBudget;
+        if (triangles.size() > max_cuts) {
+            Container<size_t> order(triangles.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&cut_depths](size_t a, size_t b) {
+                return cut_depths[a] > cut_depths[b];
+            });
+
+            Container<Triangle> deepest;
+            for (size_t i = 0; max_cuts > i; i++) {
+                deepest.push_back(triangles[order[i]]);
+            }
+            triangles = std::move(deepest);
+        }
+
         if (triangles.empty()) {
             fallback_rectangle();
             return;
@@ -240,8 +390,8 @@ namespace wk::AtlasGenerator {
 
             vertices.reserve(path.size());
             for (auto& point : path) {
-                int32_t x = (int32_t) std::ceil((point.x + crop_bound.x) * scale_factor);
-                int32_t y = (int32_t) std::ceil((point.y + crop_bound.y) * scale_factor);
+                int32_t x = (int32_t) std::ceil((point.x + crop_bound.x) * scale_factor) + m_offset.x;
+                int32_t y = (int32_t) std::ceil((point.y + crop_bound.y) * scale_factor) + m_offset.y;
                 uint16_t u = (uint16_t) std::ceil(point.x);
                 uint16_t v = (uint16_t) std::ceil(point.y);
 
@@ -256,6 +406,297 @@ namespace wk::AtlasGenerator {
         }
     };
 
+    void Item::generate_rectangle(const Config& config) {
+        load_image();
+        image_preprocess(config);
+
+        set_rectangle(config, m_crop_offset, m_image->size());
+    }
+
+    Item::Polygon Item::polygon() const {
+        Polygon result;
+        result.vertices = vertices;
+        result.crop = {(int32_t) m_crop_offset.x, (int32_t) m_crop_offset.y, width(), height()};
+        result.rectangle = m_rectangle_polygon;
+
+        return result;
+    }
+
+    void Item::apply_polygon(const Config& config, const Polygon& polygon) {
+        load_image();
+        image_preprocess(config);
+
+        const Image::Bound& crop = polygon.crop;
+        if (m_image->width() > crop.width || m_image->height() > crop.height) {
+            m_image = m_image->crop(crop);
+        }
+
+        m_crop_offset = PointF((float) crop.x, (float) crop.y);
+        vertices = polygon.vertices;
+        m_rectangle_polygon = polygon.rectangle;
+        m_status = Status::Valid;
+    }
+
+    void Item::set_rectangle(const Config& config, PointF crop_offset, Image::Size size) {
+        const float scale_factor = is_sliced() ? 1.0f : 1.f / config.scale();
+        vertices.resize(4);
+
+        int32_t x1 = (int32_t) (crop_offset.x * scale_factor) + m_offset.x;
+        int32_t y1 = (int32_t) (crop_offset.y * scale_factor) + m_offset.y;
+
+        int32_t x2 = (int32_t) ((crop_offset.x + size.x) * scale_factor) + m_offset.x;
+        int32_t y2 = (int32_t) ((crop_offset.y + size.y) * scale_factor) + m_offset.y;
+
+        uint16_t u = (uint16_t) size.x;
+        uint16_t v = (uint16_t) size.y;
+
+        vertices[3].uv = {0, 0};
+        vertices[2].uv = {0, v};
+        vertices[1].uv = {u, v};
+        vertices[0].uv = {u, 0};
+
+        vertices[3].xy = {x1, y1};
+        vertices[2].xy = {x1, y2};
+        vertices[1].xy = {x2, y2};
+        vertices[0].xy = {x2, y1};
+
+        m_rectangle_polygon = true;
+        m_status = Status::Valid;
+    }
+
+    bool Item::split_islands(const Config& config, Container<Item>& result) {
+        load_image();
+        if (m_preprocessed || is_sliced() || is_colorfill())
+            return false;
+
+        RawImageRef alpha_mask = create_alpha_mask(config.alpha_threshold());
+        if (!alpha_mask)
+            return false;
+
+        const int32_t width = alpha_mask->width();
+        const int32_t height = alpha_mask->height();
+        const int32_t distance = config.island_distance();
+
+        Container<uint8_t> mask((size_t) width * height);
+        for (int32_t h = 0; height > h; h++) {
+            for (int32_t w = 0; width > w; w++) {
+                mask[(size_t) h * width + w] = alpha_mask->at<uint8_t>((uint16_t) w, (uint16_t) h);
+            }
+        }
+
+        // Mask grown by island distance, so close regions are connected to each other
+        Container<uint8_t> grown(mask.size());
+        {
+            Container<uint8_t> rows(mask.size());
+            Container<uint32_t> prefix((size_t) std::max(width, height) + 1);
+
+            for (int32_t h = 0; height > h; h++) {
+                const uint8_t* row = &mask[(size_t) h * width];
+                for (int32_t w = 0; width > w; w++) {
+                    prefix[w + 1] = prefix[w] + (row[w] ? 1 : 0);
+                }
+
+                for (int32_t w = 0; width > w; w++) {
+                    int32_t begin = std::max(w - distance, 0);
+                    int32_t end = std::min(w + distance + 1, width);
+                    rows[(size_t) h * width + w] = prefix[end] != prefix[begin];
+                }
+            }
+
+            for (int32_t w = 0; width > w; w++) {
+                for (int32_t h = 0; height > h; h++) {
+                    prefix[h + 1] = prefix[h] + rows[(size_t) h * width + w];
+                }
+
+                for (int32_t h = 0; height > h; h++) {
+                    int32_t begin = std::max(h - distance, 0);
+                    int32_t end = std::min(h + distance + 1, height);
+                    grown[(size_t) h * width + w] = prefix[end] != prefix[begin];
+                }
+            }
+        }
+
+        // Connected components labeling
+        Container<uint32_t> labels(mask.size(), 0);
+        uint32_t label_count = 0;
+        {
+            Container<size_t> stack;
+            for (size_t i = 0; grown.size() > i; i++) {
+                if (!grown[i] || labels[i])
+                    continue;
+
+                if (++label_count > MaxIslandCount)
+                    return false;
+
+                labels[i] = label_count;
+                stack.push_back(i);
+                while (!stack.empty()) {
+                    size_t index = stack.back();
+                    stack.pop_back();
+
+                    int32_t x = (int32_t) (index % width);
+                    int32_t y = (int32_t) (index / width);
+                    for (int32_t dy = -1; dy <= 1; dy++) {
+                        for (int32_t dx = -1; dx <= 1; dx++) {
+                            int32_t nx = x + dx;
+                            int32_t ny = y + dy;
+                            if (0 > nx || 0 > ny || nx >= width || ny >= height)
+                                continue;
+
+                            size_t neighbor = (size_t) ny * width + nx;
+                            if (grown[neighbor] && !labels[neighbor]) {
+                                labels[neighbor] = label_count;
+                                stack.push_back(neighbor);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if (2 > label_count)
+            return false;
+
+        // Bounds of opaque pixels for each island (left, top, right, bottom as min and max pixel coords)
+        Container<Rect> bounds(label_count,
+                               Rect(std::numeric_limits<int32_t>::max(),
+                                    std::numeric_limits<int32_t>::max(),
+                                    std::numeric_limits<int32_t>::min(),
+                                    std::numeric_limits<int32_t>::min()));
+        for (int32_t h = 0; height > h; h++) {
+            for (int32_t w = 0; width > w; w++) {
+                size_t index = (size_t) h * width + w;
+                if (!mask[index])
+                    continue;
+
+                Rect& bound = bounds[labels[index] - 1];
+                bound.left = std::min(bound.left, w);
+                bound.top = std::min(bound.top, h);
+                bound.right = std::max(bound.right, w);
+                bound.bottom = std::max(bound.bottom, h);
+            }
+        }
+
+        {
+            Image::Bound image_bound = alpha_mask->bound();
+            size_t image_area = (size_t) image_bound.width * image_bound.height;
+
+            size_t islands_area = 0;
+            for (const Rect& bound : bounds) {
+                islands_area += (size_t) (bound.right - bound.left + 1) * (bound.bottom - bound.top + 1);
+            }
+
+            if (islands_area > image_area * IslandAreaRatio)
+                return false;
+        }
+
+        const uint8_t pixel_size = m_image->pixel_size();
+        result.reserve(label_count);
+        for (uint32_t label = 1; label_count >= label; label++) {
+            const Rect& bound = bounds[label - 1];
+            uint16_t island_width = (uint16_t) (bound.right - bound.left + 1);
+            uint16_t island_height = (uint16_t) (bound.bottom - bound.top + 1);
+
+            RawImage island(island_width, island_height, m_image->depth(), m_image->colorspace());
+            for (uint16_t h = 0; island_height > h; h++) {
+                for (uint16_t w = 0; island_width > w; w++) {
+                    int32_t x = bound.left + w;
+                    int32_t y = bound.top + h;
+
+                    uint8_t* pixel = island.at(w, h);
+                    if (labels[(size_t) y * width + x] == label) {
+                        Memory::copy(m_image->at((uint16_t) x, (uint16_t) y), pixel, pixel_size);
+                    } else {
+                        std::memset(pixel, 0, pixel_size);
+                    }
+                }
+            }
+
+            Item& part = result.emplace_back(island);
+            part.m_offset = Point(m_offset.x + bound.left, m_offset.y + bound.top);
+        }
+
+        return true;
+    }
+
+    bool Item::split_tiles(const Config& config, uint16_t max_width, uint16_t max_height, Container<Item>& result) {
+        load_image();
+        if (m_status != Status::Unset || is_colorfill())
+            return true;
+
+        // Preprocessed image is never bigger than scaled source image,
+        // so images that fit are left unprocessed and can still be split into islands
+        const float scale = is_sliced() ? 1.0f : config.scale();
+        if (max_width >= std::ceil(m_image->width() * scale) && max_height >= std::ceil(m_image->height() * scale))
+            return true;
+
+        // Guides of sliced image can not be split between tiles
+        if (is_sliced())
+            return false;
+
+        image_preprocess(config);
+
+        const int32_t width = m_image->width();
+        const int32_t height = m_image->height();
+        if (max_width >= width && max_height >= height)
+            return true;
+
+        // Tiles are placed by step of their polygons, overlap is added on both sides of each tile
+        const int32_t overlap = config.tile_overlap();
+        const int32_t step_x = max_width - overlap * 2;
+        const int32_t step_y = max_height - overlap * 2;
+        if (0 >= step_x || 0 >= step_y)
+            return false;
+
+        const float scale_factor = 1.f / config.scale();
+        const uint8_t threshold = config.alpha_threshold();
+
+        for (int32_t y = 0; height > y; y += step_y) {
+            for (int32_t x = 0; width > x; x += step_x) {
+                const int32_t right = std::min(x + step_x, width);
+                const int32_t bottom = std::min(y + step_y, height);
+
+                const int32_t left_bound = std::max(x - overlap, 0);
+                const int32_t top_bound = std::max(y - overlap, 0);
+                const int32_t right_bound = std::min(right + overlap, width);
+                const int32_t bottom_bound = std::min(bottom + overlap, height);
+
+                RawImageRef image =
+                    m_image->crop({left_bound, top_bound, right_bound - left_bound, bottom_bound - top_bound});
+
+                // Fully transparent tiles take no space in atlas
+                size_t opaque_pixels = 0;
+                Kernels::dispatch(image->depth(), [&](auto format) {
+                    using Format = decltype(format);
+                    opaque_pixels = Kernels::count_opaque<Format>(*image, threshold);
+                });
+
+                if (!opaque_pixels)
+                    continue;
+
+                Item& tile = result.emplace_back(image);
+                tile.m_tile = true;
+                tile.m_offset = m_offset;
+                tile.mark_as_custom();
+
+                int32_t x1 = (int32_t) (x * scale_factor) + m_offset.x;
+                int32_t y1 = (int32_t) (y * scale_factor) + m_offset.y;
+                int32_t x2 = (int32_t) (right * scale_factor) + m_offset.x;
+                int32_t y2 = (int32_t) (bottom * scale_factor) + m_offset.y;
+
+                uint16_t u1 = (uint16_t) (x - left_bound);
+                uint16_t v1 = (uint16_t) (y - top_bound);
+                uint16_t u2 = (uint16_t) (right - left_bound);
+                uint16_t v2 = (uint16_t) (bottom - top_bound);
+
+                tile.vertices = {
+                    Vertex(x2, y1, u2, v1), Vertex(x2, y2, u2, v2), Vertex(x1, y2, u1, v2), Vertex(x1, y1, u1, v1)};
+            }
+        }
+
+        return true;
+    }
+
     RectF Item::bound() const {
         RectF result(std::numeric_limits<float>::max(), 0, 0, std::numeric_limits<float>::max());
 
@@ -327,8 +768,201 @@ namespace wk::AtlasGenerator {
         }
     }
 
+    namespace {
+        using Clipper2Lib::PathD;
+        using Clipper2Lib::PointD;
+
+        // Same sign convention as Clipper2 Area
+        double signed_area(const PathD& path) {
+            double area = 0.0;
+            for (size_t i = 0, prev = path.size() - 1; path.size() > i; prev = i++) {
+                area += (path[prev].y + path[i].y) * (path[prev].x - path[i].x);
+            }
+
+            return area * 0.5;
+        }
+
+        // Keeps part of polygon on one side of axis aligned line
+        void clip_polygon(const PathD& input, PathD& output, bool x_axis, double value, bool keep_greater) {
+            output.clear();
+            if (input.empty())
+                return;
+
+            auto coord = [x_axis](const PointD& point) { return x_axis ? point.x : point.y; };
+            auto inside = [&](const PointD& point) {
+                return keep_greater ? coord(point) >= value : value >= coord(point);
+            };
+
+            const PointD* prev = &input.back();
+            bool prev_inside = inside(*prev);
+            for (const PointD& point : input) {
+                const bool point_inside = inside(point);
+
+                if (point_inside != prev_inside) {
+                    const double t = (value - coord(*prev)) / (coord(point) - coord(*prev));
+                    PointD& crossing = output.emplace_back(prev->x + (point.x - prev->x) * t,
+                                                           prev->y + (point.y - prev->y) * t);
+                    if (x_axis) {
+                        crossing.x = value;
+                    } else {
+                        crossing.y = value;
+                    }
+                }
+
+                if (point_inside) {
+                    output.push_back(point);
+                }
+
+                prev = &point;
+                prev_inside = point_inside;
+            }
+        }
+
+        // Removes repeated and collinear points, as Clipper2 does for its output
+        void clean_polygon(PathD& path) {
+            constexpr double epsilon = 1e-9;
+
+            bool changed = true;
+            while (changed && path.size() >= 3) {
+                changed = false;
+
+                for (size_t i = 0; path.size() > i; i++) {
+                    const PointD& prev = path[(i + path.size() - 1) % path.size()];
+                    const PointD& point = path[i];
+                    const PointD& next = path[(i + 1) % path.size()];
+
+                    const double cross =
+                        (point.x - prev.x) * (next.y - point.y) - (point.y - prev.y) * (next.x - point.x);
+                    if (std::abs(cross) <= epsilon) {
+                        path.erase(path.begin() + i);
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        bool is_convex(const PathD& path) {
+            if (path.size() < 3)
+                return false;
+
+            int orientation = 0;
+            int x_changes = 0;
+            int y_changes = 0;
+            int x_sign = 0;
+            int y_sign = 0;
+
+            for (size_t i = 0; path.size() > i; i++) {
+                const PointD& a = path[i];
+                const PointD& b = path[(i + 1) % path.size()];
+                const PointD& c = path[(i + 2) % path.size()];
+
+                const double cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+                const int turn = (cross > 0.0) - (cross < 0.0);
+                if (turn != 0) {
+                    if (orientation != 0 && turn != orientation)
+                        return false;
+                    orientation = turn;
+                }
+
+                // Self intersecting polygons with consistent turns change direction more than twice by each axis
+                const int dx = (b.x > a.x) - (b.x < a.x);
+                const int dy = (b.y > a.y) - (b.y < a.y);
+                if (dx != 0) {
+                    x_changes += x_sign != 0 && dx != x_sign;
+                    x_sign = dx;
+                }
+                if (dy != 0) {
+                    y_changes += y_sign != 0 && dy != y_sign;
+                    y_sign = dy;
+                }
+            }
+
+            return orientation != 0 && x_changes <= 2 && y_changes <= 2;
+        }
+    }
+
+    bool Item::Clip9SliceConvex(const RectF& guide,
+                                const Clipper2Lib::PathD& subject,
+                                Clipper2Lib::PathsD& result) {
+        if (guide.bottom > guide.top || guide.left > guide.right)
+            return false;
+
+        // Buffers are reused by all calls on the same thread
+        thread_local PathD polygon;
+        thread_local PathD band;
+        thread_local PathD buffer;
+        thread_local PathD slice;
+
+        polygon = subject;
+        clean_polygon(polygon);
+        if (!is_convex(polygon))
+            return false;
+
+        // Same order of slices as in rectangle intersection path: bands by y, then by x inside of each band
+        const double y_lines[2] = {guide.left, guide.right};
+        const double x_lines[2] = {guide.bottom, guide.top};
+
+        for (uint8_t y = 0; 3 > y; y++) {
+            band = polygon;
+            if (y > 0) {
+                clip_polygon(band, buffer, false, y_lines[y - 1], true);
+                std::swap(band, buffer);
+            }
+            if (y < 2) {
+                clip_polygon(band, buffer, false, y_lines[y], false);
+                std::swap(band, buffer);
+            }
+
+            for (uint8_t x = 0; 3 > x; x++) {
+                slice = band;
+                if (x > 0) {
+                    clip_polygon(slice, buffer, true, x_lines[x - 1], true);
+                    std::swap(slice, buffer);
+                }
+                if (x < 2) {
+                    clip_polygon(slice, buffer, true, x_lines[x], false);
+                    std::swap(slice, buffer);
+                }
+
+                clean_polygon(slice);
+                if (slice.size() < 3)
+                    continue;
+
+                PathD& path = result.emplace_back(slice);
+                if (signed_area(path) < 0.0) {
+                    std::reverse(path.begin(), path.end());
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void Item::get_9slice_batch(ThreadPool& pool,
+                                const Container<const Item*>& items,
+                                const Container<RectF>& guides,
+                                Container<Container<Container<VertexF>>>& results,
+                                const Container<Transformation<float>>& xy_transforms) {
+        results.resize(items.size());
+
+        pool.enumerate(items.begin(), items.end(), [&](const Item* item, size_t i) {
+            Container<Container<VertexF>>& regions = results[i];
+            regions.clear();
+
+            if (xy_transforms.empty()) {
+                item->get_9slice(guides[i], regions);
+            } else {
+                item->get_9slice(guides[i], regions, xy_transforms[i]);
+            }
+        });
+    }
+
     bool Item::operator==(const Item& other) const {
-        if (std::addressof(image()) == std::addressof(other.image()))
+        if (m_colorfill_size.x != other.m_colorfill_size.x || m_colorfill_size.y != other.m_colorfill_size.y)
+            return false;
+
+        if (m_image && m_image == other.m_image)
             return true;
 
         if (hash() != other.hash())
@@ -341,13 +975,40 @@ namespace wk::AtlasGenerator {
         if (m_preprocessed)
             return;
         if (config.scale() != 1.0f && !is_sliced()) {
-            RawImageRef resized = CreateRef<RawImage>((uint16_t) ceil(m_image->width() * config.scale()),
-                                                      (uint16_t) ceil(m_image->height() * config.scale()),
-                                                      m_image->depth(),
-                                                      m_image->colorspace());
+            // Transparent borders are cropped first so resampling is done only for visible part of image
+            Image::Bound bound = alpha_bound(*m_image, config.alpha_threshold());
+            {
+                // Keeping pixels that contribute to resampled edges
+                int32_t margin = (int32_t) std::ceil(1.f / config.scale());
+                int32_t left = std::max(bound.x - margin, 0);
+                int32_t top = std::max(bound.y - margin, 0);
+                int32_t right = std::min(bound.x + bound.width + margin, (int32_t) m_image->width());
+                int32_t bottom = std::min(bound.y + bound.height + margin, (int32_t) m_image->height());
+
+                bound = {left, top, right - left, bottom - top};
+            }
+
+            RawImageRef resized =
+                CreateRef<RawImage>((uint16_t) std::max(std::ceil(bound.width * config.scale()), 1.f),
+                                    (uint16_t) std::max(std::ceil(bound.height * config.scale()), 1.f),
+                                    m_image->depth(),
+                                    m_image->colorspace());
+
+            if (can_resample(*m_image)) {
+                resample(*m_image, bound, *resized);
+            } else {
+                RawImageRef cropped = m_image;
+                if (m_image->width() > bound.width || m_image->height() > bound.height) {
+                    cropped = m_image->crop(bound);
+                }
+
+                cropped->copy(*resized);
+            }
 
-            m_image->copy(*resized);
             m_image = resized;
+            m_borrowed = false;
+            m_offset.x += bound.x;
+            m_offset.y += bound.y;
         }
 
         int channels = m_image->channels();
@@ -358,30 +1019,81 @@ namespace wk::AtlasGenerator {
 
         m_preprocessed = true;
     }
-    void Item::alpha_preprocess() {
-        int channels = m_image->channels();
+    Image::Bound Item::alpha_bound(const RawImage& image, uint8_t threshold) {
+        const uint16_t width = image.width();
+        const uint16_t height = image.height();
 
-        for (uint16_t h = 0; height() > h; h++) {
-            for (uint16_t w = 0; width() > w; w++) {
-                switch (channels) {
-                    case 4: {
-                        ColorRGBA& pixel = m_image->at<ColorRGBA>(w, h);
-                        float alpha = (float) pixel.a / 255.f;
+        uint8_t alpha_offset = 0;
+        switch (image.channels()) {
+            case 4:
+                alpha_offset = 3;
+                break;
+            case 2:
+                alpha_offset = 1;
+                break;
+            default:
+                return {0, 0, width, height};
+        }
+
+        const uint8_t pixel_size = image.pixel_size();
+
+        int32_t left = width;
+        int32_t right = -1;
+        int32_t top = height;
+        int32_t bottom = -1;
+        for (uint16_t h = 0; height > h; h++) {
+            const uint8_t* row = image.at(0, h) + alpha_offset;
 
-                        pixel.r = (uint8_t) (pixel.r * alpha);
-                        pixel.g = (uint8_t) (pixel.g * alpha);
-                        pixel.b = (uint8_t) (pixel.b * alpha);
+            int32_t first = -1;
+            for (uint16_t w = 0; width > w; w++) {
+                if (row[(size_t) w * pixel_size] > threshold) {
+                    first = w;
+                    break;
+                }
+            }
 
-                    } break;
-                    case 2: {
-                        ColorLA& pixel = m_image->at<ColorLA>(w, h);
-                        float alpha = (float) pixel.a / 255.f;
+            if (first < 0)
+                continue;
 
-                        pixel.l = (uint8_t) (pixel.l * alpha);
-                    } break;
+            int32_t last = first;
+            for (int32_t w = width - 1; w > right && w > first; w--) {
+                if (row[(size_t) w * pixel_size] > threshold) {
+                    last = w;
+                    break;
                 }
             }
+
+            left = std::min(left, first);
+            right = std::max(right, last);
+            top = std::min(top, (int32_t) h);
+            bottom = h;
+        }
+
+        if (right < 0) {
+            return {0, 0, width, height};
         }
+
+        return {left, top, right - left + 1, bottom - top + 1};
+    }
+
+    bool Item::is_image_shared() const {
+        return m_borrowed || m_image.use_count() > 1;
+    }
+
+    void Item::alpha_preprocess() {
+        // Shared pixels are never modified, premultiplied pixels are written to own image in the same pass
+        RawImageRef destination = m_image;
+        if (is_image_shared()) {
+            destination = CreateRef<RawImage>(width(), height(), m_image->depth(), m_image->colorspace());
+        }
+
+        Kernels::dispatch(m_image->depth(), [&](auto format) {
+            using Format = decltype(format);
+            Kernels::premultiply<Format>(*m_image, *destination);
+        });
+
+        m_image = destination;
+        m_borrowed = false;
     }
 
     void Item::get_image_contour(RawImageRef image, Container<Point>& result) {
@@ -431,19 +1143,18 @@ namespace wk::AtlasGenerator {
         }
     }
 
-    void Item::normalize_mask(RawImageRef mask, const Config& config) {
-        // Pixel Normalize
-        for (uint16_t h = 0; mask->height() > h; h++) {
-            for (uint16_t w = 0; mask->width() > w; w++) {
-                uint8_t& pixel = mask->at<uint8_t>(w, h);
+    RawImageRef Item::create_alpha_mask(uint8_t threshold) const {
+        RawImageRef mask;
 
-                if (pixel > config.alpha_threshold()) {
-                    pixel = 255;
-                } else {
-                    pixel = 0;
-                };
+        Kernels::dispatch(m_image->depth(), [&](auto format) {
+            using Format = decltype(format);
+            if constexpr (Format::HasAlpha) {
+                mask = CreateRef<RawImage>(width(), height(), Image::PixelDepth::LUMINANCE8);
+                Kernels::alpha_mask<Format>(*m_image, threshold, *mask);
             }
-        }
+        });
+
+        return mask;
     }
 
     RawImageRef Item::dilate_mask(RawImageRef mask) {
@@ -487,6 +1198,136 @@ namespace wk::AtlasGenerator {
         return result;
     }
 
+    Container<Point> Item::coarse_mask_hull(const RawImage& mask) {
+        const int32_t width = mask.width();
+        const int32_t height = mask.height();
+        const int32_t block = CoarseHullBlockSize;
+        const int32_t columns = (width + block - 1) / block;
+        const int32_t rows = (height + block - 1) / block;
+
+        // Max pooling, block is opaque if any of its pixels is opaque
+        Container<uint8_t> coarse((size_t) columns * rows, 0);
+        for (int32_t h = 0; height > h; h++) {
+            const uint8_t* row = mask.at(0, (uint16_t) h);
+            uint8_t* coarse_row = &coarse[(size_t) (h / block) * columns];
+
+            for (int32_t c = 0; columns > c; c++) {
+                if (coarse_row[c])
+                    continue;
+
+                const uint8_t* begin = row + c * block;
+                const uint8_t* end = row + std::min((c + 1) * block, width);
+                coarse_row[c] = std::find(begin, end, 0xFF) != end;
+            }
+        }
+
+        auto is_opaque = [&](int32_t c, int32_t r) {
+            return c >= 0 && r >= 0 && columns > c && rows > r && coarse[(size_t) r * columns + c];
+        };
+
+        // Extreme pixels always lie in blocks with transparent neighbor, blocks deep inside are skipped
+        Container<Point> boundary;
+        Container<Point> corners;
+        for (int32_t r = 0; rows > r; r++) {
+            for (int32_t c = 0; columns > c; c++) {
+                if (!is_opaque(c, r))
+                    continue;
+
+                bool inner = true;
+                for (int32_t dy = -1; dy <= 1 && inner; dy++) {
+                    for (int32_t dx = -1; dx <= 1 && inner; dx++) {
+                        inner = is_opaque(c + dx, r + dy);
+                    }
+                }
+
+                if (inner)
+                    continue;
+
+                boundary.emplace_back(c, r);
+                corners.emplace_back(c * block, r * block);
+                corners.emplace_back((c + 1) * block, r * block);
+                corners.emplace_back((c + 1) * block, (r + 1) * block);
+                corners.emplace_back(c * block, (r + 1) * block);
+            }
+        }
+
+        // Every opaque pixel is inside of coarse hull, and pixels of full resolution hull are not farther
+        // than block diagonal from its edges. Margin also covers distance from block center to its pixels
+        const Container<Point> coarse_hull = Geometry::Hull::quick_hull(corners);
+        const float margin = (float) block * 2.5f;
+
+        auto near_hull = [&coarse_hull, margin](float x, float y) {
+            if (3 > coarse_hull.size())
+                return true;
+
+            for (size_t i = 0; coarse_hull.size() > i; i++) {
+                const Point& a = coarse_hull[i];
+                const Point& b = coarse_hull[(i + 1) % coarse_hull.size()];
+
+                const float edge_x = (float) (b.x - a.x);
+                const float edge_y = (float) (b.y - a.y);
+                const float length = edge_x * edge_x + edge_y * edge_y;
+                const float t = length > 0.f
+                                    ? std::clamp(((x - a.x) * edge_x + (y - a.y) * edge_y) / length, 0.f, 1.f)
+                                    : 0.f;
+
+                if (margin >= std::hypot(a.x + edge_x * t - x, a.y + edge_y * t - y))
+                    return true;
+            }
+
+            return false;
+        };
+
+        // Row extremes of opaque pixels are enough for hull, they are extended by 5x5 dilation kernel the same way
+        // as in full resolution path
+        Container<Point> points;
+        auto add_pixel = [&points, width, height](int32_t x, int32_t y) {
+            const int32_t left = std::max(x - 2, 0);
+            const int32_t top = std::max(y - 2, 0);
+            const int32_t right = x + 2 >= width - 1 ? width : x + 2;
+            const int32_t bottom = y + 2 >= height - 1 ? height : y + 2;
+
+            points.emplace_back(left, top);
+            points.emplace_back(right, top);
+            points.emplace_back(right, bottom);
+            points.emplace_back(left, bottom);
+        };
+
+        for (const Point& cell : boundary) {
+            const float center_x = ((float) cell.x + 0.5f) * block;
+            const float center_y = ((float) cell.y + 0.5f) * block;
+            if (!near_hull(center_x, center_y))
+                continue;
+
+            const int32_t begin_x = cell.x * block;
+            const int32_t end_x = std::min(begin_x + block, width);
+            const int32_t end_y = std::min((cell.y + 1) * block, height);
+            for (int32_t y = cell.y * block; end_y > y; y++) {
+                const uint8_t* row = mask.at(0, (uint16_t) y);
+
+                int32_t first = begin_x;
+                while (end_x > first && row[first] != 0xFF) {
+                    first++;
+                }
+
+                if (first == end_x)
+                    continue;
+
+                int32_t last = end_x - 1;
+                while (last > first && row[last] != 0xFF) {
+                    last--;
+                }
+
+                add_pixel(first, y);
+                if (last != first) {
+                    add_pixel(last, y);
+                }
+            }
+        }
+
+        return Geometry::Hull::quick_hull(points);
+    }
+
     bool Item::verify_vertices() {
         std::vector<PointUV> points;
         points.resize(vertices.size());
@@ -502,11 +1343,29 @@ namespace wk::AtlasGenerator {
         return true;
     }
 
-    std::size_t Item::hash() const {
+    Hash128 Item::hash() const {
+        if (!m_hash) {
+            load_image();
+            m_hash = hash128(m_image->data(), m_image->data_length(), hash_seed(*m_image));
+        }
+
+        return m_hash.value();
+    }
+
+    Hash128 Item::hash(ThreadPool& pool) const {
         if (!m_hash) {
-            m_hash = m_image->hash();
+            load_image();
+            m_hash = hash128(pool, m_image->data(), m_image->data_length(), hash_seed(*m_image));
         }
 
-        return m_hash;
+        return m_hash.value();
+    }
+
+    uint64_t Item::hash_seed(const RawImage& image) const {
+        const uint64_t shape =
+            (uint64_t) image.width() | (uint64_t) image.height() << 16 | (uint64_t) image.depth() << 32;
+        const uint64_t colorfill = (uint64_t) m_colorfill_size.x | (uint64_t) m_colorfill_size.y << 16;
+
+        return shape ^ colorfill * 0x9E3779B185EBCA87ull;
     }
 }
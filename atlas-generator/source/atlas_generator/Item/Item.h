@@ -1,7 +1,10 @@
 #pragma once
 
 #include "Vertex.h"
+#include "atlas_generator/Cache/Hash.h"
 #include "atlas_generator/Config.h"
+#include "atlas_generator/IO/ScratchFile.h"
+#include "atlas_generator/Threading/ThreadPool.h"
 #include "core/geometry/convex.hpp"
 #include "core/geometry/intersect.hpp"
 #include "core/image/raw_image.h"
@@ -49,7 +52,13 @@ namespace wk::AtlasGenerator {
         enum class Status : uint8_t {
             Unset = 0,
             Valid,
-            InvalidPolygon
+            InvalidPolygon,
+
+            // Fully transparent image, item is not placed to atlas
+            Empty,
+
+            // Item failed in partial success mode, item is not placed to atlas
+            Skipped
         };
 
         enum FixedRotation : uint16_t {
@@ -59,8 +68,22 @@ namespace wk::AtlasGenerator {
             Rotation270 = 270
         };
 
+        // Separately packed piece of item
+        struct Part {
+            size_t texture_index = 0xFF;
+            Container<Vertex> vertices;
+            Transformation<int32_t> transform;
+        };
+
     public:
         Item(const RawImage& image, bool sliced = false);
+
+        /// @brief Shares provided image without copying. Pixels are copied only if item needs to modify them
+        Item(RawImageRef image, bool sliced = false);
+
+        /// @brief Borrows caller owned pixel buffer without copying. Buffer must stay alive until generation is done
+        Item(uint8_t* data, uint16_t width, uint16_t height, Image::PixelDepth depth, bool sliced = false);
+
         Item(const ColorRGBA& color);
         Item(std::filesystem::path path, bool sliced = false);
 
@@ -72,8 +95,14 @@ namespace wk::AtlasGenerator {
         uint16_t width() const;
         uint16_t height() const;
 
-        const RawImage& image() const { return *m_image; };
-        const RawImageRef& image_ref() const { return m_image; };
+        // Evicted pixels are loaded back on access
+        const RawImage& image() const;
+        const RawImageRef& image_ref() const;
+
+        /// @brief Moves own pixels to scratch file, they are loaded back on next access to image
+        /// @return Count of released bytes, 0 if pixels are shared and can't be released
+        size_t spill(const Ref<ScratchFile>& file);
+        bool is_spilled() const;
 
         // Generator Info
     public:
@@ -83,19 +112,69 @@ namespace wk::AtlasGenerator {
         // UV Transformation
         Transformation<int32_t> transform;
 
+        // Filled instead of vertices when item was packed as several parts
+        Container<Part> parts;
+
     public:
         bool is_rectangle() const;
         bool is_sliced() const;
         bool is_colorfill() const { return m_colorfill; };
+        bool is_multipart() const { return !parts.empty(); };
+
+        /// @brief Polygon of item was replaced by bound rectangle of its image
+        bool has_rectangle_polygon() const { return m_rectangle_polygon; };
         std::optional<AtlasGenerator::Vertex> get_colorfill() const;
 
+        /// @brief Size of colorfill quad in xy coords
+        Point colorfill_size(const Config& config) const;
+
     public:
         // XY coords bound
         RectF bound() const;
         RectUV bound_uv() const;
         void generate_image_polygon(const Config& config);
+
+        /// @brief Replaces polygon by bound of current image. Used for items which polygon can not be generated
+        void generate_rectangle(const Config& config);
+
+        /// @brief Result of polygon generation without pixels, so it can be kept after item pixels are released
+        struct Polygon {
+            Container<Vertex> vertices;
+
+            // Bound of image cropped by polygon generation in preprocessed image
+            Image::Bound crop;
+            bool rectangle = false;
+        };
+
+        /// @brief Polygon of item with generated polygon
+        Polygon polygon() const;
+
+        /// @brief Preprocesses image and applies polygon generated for item with the same source image and config
+        void apply_polygon(const Config& config, const Polygon& polygon);
+
+        /// @brief Marks fully transparent item as Empty and turns single color item into colorfill
+        /// that keeps size of source image
+        void detect_uniform(const Config& config);
+
         bool mark_as_custom();
         bool mark_as_preprocessed();
+        void mark_as_skipped();
+
+        /// @brief Splits image into separated opaque regions
+        /// @param config Generator config
+        /// @param result Output items, one per region
+        /// @return True if image has enough separated regions to be packed by parts
+        bool split_islands(const Config& config, Container<Item>& result);
+
+        /// @brief Splits preprocessed image into overlapping tiles with rectangle polygons
+        /// @param max_width Maximal tile width with overlap, in pixels of preprocessed image
+        /// @param max_height Maximal tile height with overlap, in pixels of preprocessed image
+        /// @param result Output items, one per tile with visible pixels
+        /// @return False if image does not fit into provided size and can not be split
+        bool split_tiles(const Config& config, uint16_t max_width, uint16_t max_height, Container<Item>& result);
+
+        /// @brief True for tile of oversized image. Tile image is bigger than its polygon by tile overlap
+        bool is_tile() const { return m_tile; };
 
     public:
         /// @brief Splits provided vertex array into 9 slices accroding to provided guide
@@ -120,34 +199,37 @@ namespace wk::AtlasGenerator {
                                          vertex.xy.y + xy_transform.translation.y);
                 }
 
-                constexpr float min = (float) std::numeric_limits<int>::min();
-                constexpr float max = (float) std::numeric_limits<int>::max();
+                // Convex polygons and rectangles are sliced in closed form
+                if (!Clip9SliceConvex(guide, subject, result_solution)) {
+                    constexpr float min = (float) std::numeric_limits<int>::min();
+                    constexpr float max = (float) std::numeric_limits<int>::max();
 
-                const Container<RectF> rects = {
-                    {min, min, guide.left, guide.bottom},       // Left-Top
-                    {min, guide.bottom, guide.left, guide.top}, // Top-Middle
-                    {guide.left, guide.top, min, max},          // Right-Top
+                    const Container<RectF> rects = {
+                        {min, min, guide.left, guide.bottom},       // Left-Top
+                        {min, guide.bottom, guide.left, guide.top}, // Top-Middle
+                        {guide.left, guide.top, min, max},          // Right-Top
 
-                    {guide.left, min, guide.right, guide.bottom},       // Left-Middle
-                    {guide.left, guide.bottom, guide.right, guide.top}, // Middle
-                    {guide.left, guide.top, guide.right, max},          // Middle-bottom
+                        {guide.left, min, guide.right, guide.bottom},       // Left-Middle
+                        {guide.left, guide.bottom, guide.right, guide.top}, // Middle
+                        {guide.left, guide.top, guide.right, max},          // Middle-bottom
 
-                    {guide.right, guide.bottom, max, min},       // Left-bottom
-                    {guide.right, guide.top, max, guide.bottom}, // Middle-bottom
-                    {guide.right, guide.top, max, max},          // Right-bottom
+                        {guide.right, guide.bottom, max, min},       // Left-bottom
+                        {guide.right, guide.top, max, guide.bottom}, // Middle-bottom
+                        {guide.right, guide.top, max, max},          // Right-bottom
 
-                };
+                    };
 
-                for (const RectF& rect : rects) {
-                    PathD path;
+                    for (const RectF& rect : rects) {
+                        PathD path;
 
-                    path.emplace_back(rect.bottom, rect.left);
-                    path.emplace_back(rect.bottom, rect.right);
-                    path.emplace_back(rect.top, rect.right);
-                    path.emplace_back(rect.top, rect.left);
+                        path.emplace_back(rect.bottom, rect.left);
+                        path.emplace_back(rect.bottom, rect.right);
+                        path.emplace_back(rect.top, rect.right);
+                        path.emplace_back(rect.top, rect.left);
 
-                    PathsD solution = Intersect({subject}, {path}, FillRule::NonZero, 8);
-                    result_solution.insert(result_solution.end(), solution.begin(), solution.end());
+                        PathsD solution = Intersect({subject}, {path}, FillRule::NonZero, 8);
+                        result_solution.insert(result_solution.end(), solution.begin(), solution.end());
+                    }
                 }
             }
 
@@ -170,29 +252,87 @@ namespace wk::AtlasGenerator {
                         Container<Container<VertexF>>& regions,
                         const Transformation<float> xy_transform = Transformation<float>()) const;
 
+        /// @brief Splits polygons of many items to 9 slices in parallel
+        /// @param pool Thread pool
+        /// @param items Items to slice
+        /// @param guides Slice guide for each item
+        /// @param results Output splited regions for each item
+        /// @param xy_transforms Vertices transformation for each item. Can be empty
+        static void get_9slice_batch(ThreadPool& pool,
+                                     const Container<const Item*>& items,
+                                     const Container<RectF>& guides,
+                                     Container<Container<Container<VertexF>>>& results,
+                                     const Container<Transformation<float>>& xy_transforms = {});
+
     public:
         bool operator==(const Item& other) const;
 
+        // 128-bit hash of item image, calculated once. Copied images get it while being copied.
+        // Equal items are also equal in colorfill size, so one can be placed by xy of another
+        Hash128 hash() const;
+
+        // The same hash, pixels of big images are hashed by chunks on pool
+        Hash128 hash(ThreadPool& pool) const;
+
     private:
+        // Slices convex polygon with Sutherland-Hodgman clipping by guide lines.
+        // Returns false if polygon is not convex or guide is inverted
+        static bool Clip9SliceConvex(const RectF& guide,
+                                     const Clipper2Lib::PathD& subject,
+                                     Clipper2Lib::PathsD& result);
+
         void image_preprocess(const Config& config);
+
+        // Sets rectangle polygon for image of given size at given offset in preprocessed image
+        void set_rectangle(const Config& config, PointF crop_offset, Image::Size size);
         void alpha_preprocess();
 
+        void load_image() const;
+
+        // True if image pixels are owned by someone else and must not be modified in place
+        bool is_image_shared() const;
+
+        // Bound of pixels that are visible with provided alpha threshold
+        static Image::Bound alpha_bound(const RawImage& image, uint8_t threshold);
+
         void get_image_contour(RawImageRef image, Container<Point>& result);
 
-        void normalize_mask(RawImageRef mask, const Config& config);
+        // Binary mask of pixels with alpha above threshold. Null if image has no alpha channel
+        RawImageRef create_alpha_mask(uint8_t threshold) const;
         RawImageRef dilate_mask(RawImageRef mask);
 
+        // Convex hull of dilated mask for large images. Hull of max pooled mask selects blocks near hull edges,
+        // only these blocks are scanned at full resolution, so result still contains every opaque pixel
+        static Container<Point> coarse_mask_hull(const RawImage& mask);
+
         bool verify_vertices();
 
-        std::size_t hash() const;
+        // Seed for image hash, so images with the same pixels and different shape have different hashes.
+        // Detected colorfill items also mix in size of their source image
+        uint64_t hash_seed(const RawImage& image) const;
 
     protected:
         Status m_status = Status::Unset;
         bool m_preprocessed = false;
         bool m_sliced = false;
         bool m_colorfill = false;
+        bool m_tile = false;
+        bool m_rectangle_polygon = false;
+
+        // Size of source image of detected single color item, zero for explicit colorfill
+        Point m_colorfill_size = Point(0, 0);
+
+        mutable RawImageRef m_image;
+        bool m_borrowed = false;
+
+        // Location of pixels in scratch file, kept after loading so unchanged pixels are not written again
+        Ref<SpilledImage> m_spilled;
+        mutable std::optional<Hash128> m_hash;
+
+        // Offset of image in xy coords of source item
+        Point m_offset = Point(0, 0);
 
-        RawImageRef m_image;
-        mutable size_t m_hash = 0;
+        // Offset of image cropped by polygon generation in preprocessed image
+        PointF m_crop_offset = PointF(0.0f, 0.0f);
     };
 }
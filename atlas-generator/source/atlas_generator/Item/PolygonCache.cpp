@@ -0,0 +1,66 @@
+#include "PolygonCache.h"
+
+#include <algorithm>
+
+namespace wk::AtlasGenerator {
+    PolygonCache::PolygonCache(size_t capacity) :
+        m_capacity(std::max<size_t>(capacity, 1)) {
+    }
+
+    bool PolygonCache::load(const Hash128& key, const Config& config, Item& item) {
+        Item::Polygon polygon;
+        {
+            std::lock_guard lock(m_mutex);
+            auto it = m_polygons.find(key);
+            if (it == m_polygons.end())
+                return false;
+
+            m_order.splice(m_order.begin(), m_order, it->second.position);
+            polygon = it->second.polygon;
+        }
+
+        // Preprocessing of item pixels is done outside of lock
+        item.apply_polygon(config, polygon);
+        return true;
+    }
+
+    void PolygonCache::store(const Hash128& key, const Item& item) {
+        Item::Polygon polygon = item.polygon();
+
+        std::lock_guard lock(m_mutex);
+        if (m_polygons.count(key))
+            return;
+
+        if (m_polygons.size() >= m_capacity) {
+            m_polygons.erase(m_order.back());
+            m_order.pop_back();
+        }
+
+        m_order.push_front(key);
+        m_polygons.emplace(key, Entry{std::move(polygon), m_order.begin()});
+    }
+
+    size_t PolygonCache::size() const {
+        std::lock_guard lock(m_mutex);
+        return m_polygons.size();
+    }
+
+    void PolygonCache::clear() {
+        std::lock_guard lock(m_mutex);
+        m_polygons.clear();
+        m_order.clear();
+    }
+
+    Hash128 PolygonCache::key(const Item& item, const Config& config) {
+        Hasher hasher;
+        hasher.update(item.hash());
+        hasher.update(item.width());
+        hasher.update(item.height());
+        hasher.update(item.is_sliced());
+        hasher.update(config.scale());
+        hasher.update(config.alpha_threshold());
+        hasher.update(config.vertex_budget());
+
+        return hasher.digest();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Item.h"
+#include "atlas_generator/Constants.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace wk::AtlasGenerator {
+    // Thread safe storage of item polygons that can be shared between generators,
+    // so identical sprites of different jobs get their polygon generated only once.
+    // Only polygons are kept, pixels stay owned by items, so they can still be spilled
+    class PolygonCache {
+    public:
+        /// @param capacity Count of kept polygons, the least recently used ones are evicted
+        PolygonCache(size_t capacity = DefaultPolygonCacheCapacity);
+
+        PolygonCache(const PolygonCache&) = delete;
+        PolygonCache& operator=(const PolygonCache&) = delete;
+
+    public:
+        /// @brief Builds key from source image and config fields that affect item processing.
+        /// Key must be calculated before item is processed
+        static Hash128 key(const Item& item, const Config& config);
+
+        /// @brief Applies cached polygon to provided item
+        /// @return True if item was found
+        bool load(const Hash128& key, const Config& config, Item& item);
+
+        /// @brief Stores polygon of processed item
+        void store(const Hash128& key, const Item& item);
+
+        size_t size() const;
+        void clear();
+
+    private:
+        struct Entry {
+            Item::Polygon polygon;
+            std::list<Hash128>::iterator position;
+        };
+
+        mutable std::mutex m_mutex;
+        size_t m_capacity;
+        std::unordered_map<Hash128, Entry> m_polygons;
+
+        // Keys from the most recently used to the least
+        std::list<Hash128> m_order;
+    };
+}
@@ -9,7 +9,8 @@ namespace wk::AtlasGenerator {
             Unknown = 0,
             TooBigImage,
             UnsupportedImage,
-            InvalidPolygon
+            InvalidPolygon,
+            Cancelled
         };
 
     public:
@@ -27,6 +28,9 @@ namespace wk::AtlasGenerator {
                 case Reason::InvalidPolygon:
                     m_message = "Failed to generate polygon for image";
                     break;
+                case Reason::Cancelled:
+                    m_message = "Generation was cancelled";
+                    break;
                 default:
                     m_message = "Unknown exception";
                     break;
@@ -45,4 +49,10 @@ namespace wk::AtlasGenerator {
         Reason m_reason;
         size_t m_item_index;
     };
+
+    // Item that was skipped or packed as rectangle in partial success mode
+    struct ItemFailure {
+        size_t index;
+        PackagingException::Reason reason;
+    };
 }
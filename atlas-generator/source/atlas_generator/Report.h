@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace wk::AtlasGenerator {
+    // Occupancy of one atlas page, areas are in texels
+    struct PageReport {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        size_t item_count = 0;
+
+        // Texels with alpha above threshold, including extrusion
+        size_t opaque_pixels = 0;
+
+        // Area of item polygons
+        double polygon_area = 0.0;
+
+        // Estimated area of extrusion band around item polygons
+        double extrusion_area = 0.0;
+
+        // Area that is covered neither by polygons nor by their extrusion
+        double wasted_area = 0.0;
+
+        size_t area() const { return (size_t) width * height; };
+        double opaque_coverage() const { return area() ? (double) opaque_pixels / area() : 0.0; };
+        double polygon_coverage() const { return area() ? polygon_area / area() : 0.0; };
+    };
+
+    // Packing efficiency of one generate call
+    struct PackingReport {
+        std::vector<PageReport> pages;
+
+        size_t item_count = 0;
+        size_t unique_item_count = 0;
+        size_t duplicate_count = 0;
+        size_t empty_count = 0;
+        size_t colorfill_count = 0;
+
+        // Unique items that are packed as rectangles, including fallbacks of failed polygons
+        size_t rectangle_count = 0;
+
+        // Texels with alpha above threshold in unique items
+        size_t unique_opaque_pixels = 0;
+
+        size_t atlas_bytes = 0;
+
+        // Bytes that duplicate items would take in atlases without deduplication
+        size_t duplicate_bytes = 0;
+
+        // Result was loaded from result cache, only page statistics are available
+        bool cached = false;
+
+        double bytes_per_opaque_pixel() const {
+            return unique_opaque_pixels ? (double) atlas_bytes / unique_opaque_pixels : 0.0;
+        };
+    };
+}
@@ -0,0 +1,227 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace wk::AtlasGenerator {
+    namespace {
+        // Index of pool worker that runs current thread
+        thread_local const ThreadPool* current_pool = nullptr;
+        thread_local size_t current_worker = SIZE_MAX;
+
+        // Count of tasks that current thread runs one inside of another
+        thread_local size_t task_depth = 0;
+
+        // Tasks per thread for parallel loops, gives some space for stealing
+        constexpr size_t ChunksPerThread = 4;
+    }
+
+    ThreadPool::ThreadPool(size_t thread_count, bool pin_threads) {
+        if (!thread_count) {
+            thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        m_workers.reserve(thread_count - 1);
+        for (size_t i = 0; thread_count - 1 > i; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+
+        for (size_t i = 0; m_workers.size() > i; i++) {
+            m_workers[i]->thread = std::thread(&ThreadPool::worker_loop, this, i);
+
+            if (pin_threads) {
+                pin_thread(m_workers[i]->thread, i + 1);
+            }
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+
+        for (auto& worker : m_workers) {
+            worker->thread.join();
+        }
+    }
+
+    void ThreadPool::push(Task&& task) {
+        if (current_pool == this && current_worker != SIZE_MAX) {
+            Worker& worker = *m_workers[current_worker];
+
+            std::lock_guard lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        } else {
+            std::lock_guard lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+
+        notify();
+    }
+
+    void ThreadPool::push_job(Task&& task) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_jobs.push_back(std::move(task));
+        }
+        m_pending_jobs++;
+
+        notify();
+    }
+
+    void ThreadPool::notify() {
+        m_pending++;
+        {
+            std::lock_guard lock(m_mutex);
+        }
+        m_condition.notify_one();
+
+        if (m_waiting) {
+            m_wait_condition.notify_all();
+        }
+    }
+
+    bool ThreadPool::pop(Task& task, size_t worker_index, bool allow_jobs) {
+        // Own tasks first, newest ones are hot in cache
+        if (worker_index != SIZE_MAX) {
+            Worker& worker = *m_workers[worker_index];
+
+            std::lock_guard lock(worker.mutex);
+            if (!worker.tasks.empty()) {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                return true;
+            }
+        }
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (!m_tasks.empty()) {
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                return true;
+            }
+        }
+
+        // Stealing oldest tasks from other workers
+        const size_t offset = worker_index == SIZE_MAX ? 0 : worker_index + 1;
+        for (size_t i = 0; m_workers.size() > i; i++) {
+            Worker& victim = *m_workers[(offset + i) % m_workers.size()];
+
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        // New jobs go last, so started ones finish first
+        if (allow_jobs) {
+            std::lock_guard lock(m_mutex);
+            if (!m_jobs.empty()) {
+                task = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_pending_jobs--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::run_pending_task() {
+        Task task;
+        if (!pop(task, current_pool == this ? current_worker : SIZE_MAX, task_depth == 0))
+            return false;
+
+        m_pending--;
+        task_depth++;
+        task();
+        task_depth--;
+
+        // Waiters may have been waiting for this task
+        if (m_waiting) {
+            {
+                std::lock_guard lock(m_mutex);
+            }
+            m_wait_condition.notify_all();
+        }
+
+        return true;
+    }
+
+    void ThreadPool::worker_loop(size_t index) {
+        current_pool = this;
+        current_worker = index;
+
+        while (true) {
+            if (run_pending_task())
+                continue;
+
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop.load() || m_pending.load() > 0; });
+
+            if (m_stop && !m_pending)
+                return;
+        }
+    }
+
+    void ThreadPool::wait_until(const std::function<bool()>& ready) {
+        while (!ready()) {
+            if (run_pending_task())
+                continue;
+
+            // Nested waits can not start jobs, so pending jobs do not wake them
+            const bool allow_jobs = task_depth == 0;
+            std::unique_lock lock(m_mutex);
+            m_waiting++;
+            m_wait_condition.wait(lock, [&]() {
+                const size_t pending = m_pending;
+                const size_t jobs = allow_jobs ? 0 : m_pending_jobs.load();
+                return pending > jobs || ready();
+            });
+            m_waiting--;
+        }
+    }
+
+    void ThreadPool::wait_all(std::vector<std::future<void>>& results) {
+        for (auto& result : results) {
+            wait_until([&result]() { return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        }
+
+        // Rethrows first exception
+        for (auto& result : results) {
+            result.get();
+        }
+    }
+
+    size_t ThreadPool::chunk_size_for(size_t count) const {
+        return std::max<size_t>(count / (thread_count() * ChunksPerThread), 1);
+    }
+
+    void ThreadPool::pin_thread(std::thread& thread, size_t core) {
+        const size_t core_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        core %= core_count;
+
+#if defined(_WIN32)
+        SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR) 1 << core);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &set);
+#else
+        (void) thread;
+#endif
+    }
+}
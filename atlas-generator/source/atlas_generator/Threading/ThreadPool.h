@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace wk::AtlasGenerator {
+    // Work stealing thread pool shared by all parallel stages of generator.
+    // Thread that waits for pool tasks executes pending tasks meanwhile, so it is counted as one of pool threads
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>;
+
+    public:
+        /// @param thread_count Count of threads including calling thread. 0 means hardware concurrency
+        /// @param pin_threads Binds each worker to its own CPU core
+        ThreadPool(size_t thread_count = 0, bool pin_threads = false);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+    public:
+        size_t thread_count() const { return m_workers.size() + 1; };
+
+        template <typename F>
+        auto submit(F&& function) -> std::future<std::invoke_result_t<F>> {
+            using Result = std::invoke_result_t<F>;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+            std::future<Result> result = task->get_future();
+            push([task]() { (*task)(); });
+
+            return result;
+        }
+
+        /// @brief Submits independent job. Jobs are started only by threads that do not run other task,
+        /// so waits inside of one job never run other jobs on the same stack
+        template <typename F>
+        auto submit_job(F&& function) -> std::future<std::invoke_result_t<F>> {
+            using Result = std::invoke_result_t<F>;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+            std::future<Result> result = task->get_future();
+            push_job([task]() { (*task)(); });
+
+            return result;
+        }
+
+        /// @brief Waits for result of submitted task, executing other tasks meanwhile.
+        /// Sleeps while there is nothing to execute
+        template <typename T>
+        T wait(std::future<T>& future) {
+            wait_until([&future]() { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+            return future.get();
+        }
+
+        /// @brief Calls function(element, index) for each element of range in parallel and waits for completion
+        template <typename It, typename F>
+        void enumerate(It begin, It end, F&& function) {
+            const size_t count = (size_t) std::distance(begin, end);
+            if (!count)
+                return;
+
+            const size_t chunk_size = chunk_size_for(count);
+
+            std::vector<std::future<void>> results;
+            results.reserve((count + chunk_size - 1) / chunk_size);
+            for (size_t offset = 0; count > offset; offset += chunk_size) {
+                It chunk_begin = std::next(begin, offset);
+                size_t chunk_end = std::min(offset + chunk_size, count);
+
+                results.push_back(submit([&function, chunk_begin, offset, chunk_end]() {
+                    It it = chunk_begin;
+                    for (size_t i = offset; chunk_end > i; i++, ++it) {
+                        function(*it, i);
+                    }
+                }));
+            }
+
+            wait_all(results);
+        }
+
+        /// @brief Finds first element of range that satisfies predicate, chunks of range are checked in parallel
+        template <typename It, typename P>
+        It find_if(It begin, It end, P&& predicate) {
+            const size_t count = (size_t) std::distance(begin, end);
+            const size_t chunk_size = chunk_size_for(count);
+            if (count <= chunk_size)
+                return std::find_if(begin, end, predicate);
+
+            // Index of first found element, chunks after it are skipped
+            std::atomic<size_t> found = count;
+
+            std::vector<std::future<void>> results;
+            for (size_t offset = 0; count > offset; offset += chunk_size) {
+                It chunk_begin = std::next(begin, offset);
+                size_t chunk_end = std::min(offset + chunk_size, count);
+
+                results.push_back(submit([&predicate, &found, chunk_begin, offset, chunk_end]() {
+                    It it = chunk_begin;
+                    for (size_t i = offset; chunk_end > i && found.load() > i; i++, ++it) {
+                        if (predicate(*it)) {
+                            size_t current = found.load();
+                            while (current > i && !found.compare_exchange_weak(current, i)) {
+                            }
+                            return;
+                        }
+                    }
+                }));
+            }
+
+            wait_all(results);
+            return std::next(begin, found.load());
+        }
+
+    private:
+        struct Worker {
+            std::thread thread;
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void push(Task&& task);
+        void push_job(Task&& task);
+        void notify();
+        bool pop(Task& task, size_t worker_index, bool allow_jobs);
+        bool run_pending_task();
+        void worker_loop(size_t index);
+
+        // Runs pending tasks until condition is met, sleeps until task is pushed or finished if none can be run
+        void wait_until(const std::function<bool()>& ready);
+
+        void wait_all(std::vector<std::future<void>>& results);
+        size_t chunk_size_for(size_t count) const;
+
+        static void pin_thread(std::thread& thread, size_t core);
+
+    private:
+        std::vector<std::unique_ptr<Worker>> m_workers;
+
+        // Queue for tasks submitted from outside of pool threads
+        std::mutex m_mutex;
+        std::deque<Task> m_tasks;
+        std::deque<Task> m_jobs;
+
+        std::condition_variable m_condition;
+        std::atomic<size_t> m_pending = 0;
+        std::atomic<size_t> m_pending_jobs = 0;
+
+        // Threads that wait for tasks, woken when task is pushed or finished
+        std::condition_variable m_wait_condition;
+        std::atomic<size_t> m_waiting = 0;
+        std::atomic<bool> m_stop = false;
+    };
+}